@@ -5,62 +5,69 @@
 void apu_initialize(APU* apu) {
     memset(apu, 0, sizeof(APU));
     apu->nr52 = 0xF1;
+    apu->sample_rate = APU_SAMPLE_RATE;
 }
 
-void apu_cycle(APU* apu, MMU* mmu) {
-    static int phase = 0;
+static int16_t apu_sample(APU* apu, MMU* mmu) {
+    int elapsed = apu->cycles;
+    apu->cycles = 0;
 
     // check sound enabled
     if (!(mmu_read(mmu, 0xFF26) & 0x80)) {
-        // output silence
-        memset(apu->buffer, 0, sizeof(apu->buffer));
-        apu->buffer_position = 0;
-        return;
+        return 0;
     }
 
     // check DAC enabled
     uint8_t nr12 = mmu_read(mmu, 0xFF12);
     if ((nr12 & 0xF8) == 0) {
-        // output silence
-        memset(apu->buffer, 0, sizeof(apu->buffer));
-        apu->buffer_position = 0;
-        return;
+        return 0;
     }
 
     // check channel enabled
     uint8_t nr14 = mmu_read(mmu, 0xFF14);
     if (!(nr14 & 0x80)) {
-        // output silence
-        memset(apu->buffer, 0, sizeof(apu->buffer));
-        apu->buffer_position = 0;
-        return;
+        return 0;
     }
 
-    // square 1 - frequency low and high
+    // square 1 - frequency low and high, each of the 8 duty steps lasts 4 * (2048 - frequency) cycles
     uint8_t nr13 = mmu_read(mmu, 0xFF13);
     int frequency = nr13 | ((nr14 & 0x07) << 8);
-    int wave_length = 2048 - frequency;
+    int step = (2048 - frequency) * 4;
+    apu->phase = (apu->phase + elapsed) % (step * 8);
 
     // duty cycle
     uint8_t nr11 = mmu_read(mmu, 0xFF11);
     int duty_cycle = (nr11 >> 6) & 0x03;
+    int duty_pos = apu->phase / step;
+
+    // square wave
+    switch (duty_cycle) {
+        case 0: return (duty_pos < 1) ? 3000 : -3000; // 12.5% duty cycle
+        case 1: return (duty_pos < 2) ? 3000 : -3000; // 25% duty cycle
+        case 2: return (duty_pos < 4) ? 3000 : -3000; // 50% duty cycle
+        default: return (duty_pos < 6) ? 3000 : -3000; // 75% duty cycle
+    }
+}
 
-    if (apu->buffer_position < sizeof(apu->buffer) / sizeof(apu->buffer[0])) {
-        int amplitude = 0;
+void apu_cycle(APU* apu, MMU* mmu, int cycles) {
+    // registers are only looked at when a sample falls due
+    apu->cycles += cycles;
+    apu->sample_clock += (uint64_t)cycles * apu->sample_rate;
 
-        int duty_pos = phase / (wave_length / 8);
+    while (apu->sample_clock >= APU_CLOCK) {
+        apu->sample_clock -= APU_CLOCK;
+        int16_t sample = apu_sample(apu, mmu);
+        if (apu->silent) {
+            continue;
+        }
 
-        // square wave
-        switch (duty_cycle) {
-            case 0: amplitude = (duty_pos < 1) ? 3000 : -3000; break; // 12.5% duty cycle
-            case 1: amplitude = (duty_pos < 2) ? 3000 : -3000; break; // 25% duty cycle
-            case 2: amplitude = (duty_pos < 4) ? 3000 : -3000; break; // 50% duty cycle
-            case 3: amplitude = (duty_pos < 6) ? 3000 : -3000; break; // 75% duty cycle
+        if (apu->buffer_position < sizeof(apu->buffer) / sizeof(apu->buffer[0])) {
+            apu->buffer[apu->buffer_position++] = sample;
         }
 
-        // fill buffer and increment phase
-        apu->buffer[apu->buffer_position++] = amplitude;
-        phase = (phase + 1) % wave_length;
+        if (apu->writer != NULL) {
+            wav_write(apu->writer, sample);
+        }
     }
 }
 
@@ -2,7 +2,12 @@
 #define APU_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "mmu.h"
+#include "wav.h"
+
+#define APU_CLOCK 4194304 // t-cycles per second
+#define APU_SAMPLE_RATE 44100
 
 typedef struct {
     // audio registers
@@ -12,13 +17,25 @@ typedef struct {
     uint8_t nr41, nr42, nr43, nr44;       // 4 - noise
     uint8_t nr50, nr51, nr52;             // control registers
 
+    // sample clock - a sample is due each time it passes APU_CLOCK
+    int sample_rate;
+    uint64_t sample_clock;
+    int cycles; // since the last sample
+    int phase;
+
     // audio buffer
     int16_t buffer[735 * 2]; // one frame at 44100Hz
     int buffer_position;
+
+    // export, NULL when only playing
+    WavWriter* writer;
+
+    // frames that will be rolled back make no sound
+    bool silent;
 } APU;
 
 void apu_initialize(APU* apu);
-void apu_cycle(APU* apu, MMU* mmu);
+void apu_cycle(APU* apu, MMU* mmu, int cycles);
 void audio_callback(void* userdata, uint8_t* stream, int len);
 
 #endif
@@ -1,25 +1,138 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "cart.h"
 
+static uint64_t cart_ticks() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void cart_parse_type(Cart* cart) {
+    cart->cgb = cart->data[0x143] & 0x80;
+    cart->type = cart->data[0x147];
+
+    switch (cart->type) {
+        case 0x01: case 0x02: case 0x03:
+            cart->mbc = 1;
+            break;
+        case 0x05: case 0x06:
+            cart->mbc = 2;
+            break;
+        case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13:
+            cart->mbc = 3;
+            break;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+            cart->mbc = 5;
+            break;
+        default:
+            cart->mbc = 0;
+            break;
+    }
+
+    switch (cart->type) {
+        case 0x03: case 0x06: case 0x09: case 0x0D: case 0x0F:
+        case 0x10: case 0x13: case 0x1B: case 0x1E: case 0xFF:
+            cart->battery = true;
+            break;
+        default:
+            cart->battery = false;
+            break;
+    }
+
+    // mbc2 has 512 half-bytes built in, everything else reports its size
+    static const long ram_sizes[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+    uint8_t ram_code = cart->data[0x149];
+    if (cart->mbc == 2) {
+        cart->ram_size = 0x200;
+    } else if (ram_code < sizeof(ram_sizes) / sizeof(ram_sizes[0])) {
+        cart->ram_size = ram_sizes[ram_code];
+    }
+
+    // plain rom carts have nothing to enable
+    cart->ram_enabled = cart->mbc == 0;
+}
+
+static bool cart_open_save(Cart* cart, const char* path) {
+    // <rom>.gb -> <rom>.sav
+    char save_path[4096];
+    snprintf(save_path, sizeof(save_path), "%s", path);
+    char* ext = strrchr(save_path, '.');
+    char* dir = strrchr(save_path, '/');
+    if (ext != NULL && (dir == NULL || ext > dir)) {
+        *ext = '\0';
+    }
+    strncat(save_path, ".sav", sizeof(save_path) - strlen(save_path) - 1);
+
+    cart->save_fd = open(save_path, O_RDWR | O_CREAT, 0644);
+    if (cart->save_fd < 0) {
+        fprintf(stderr, "Error: Couldn't open save %s\n", save_path);
+        return false;
+    }
+
+    // grow short or new saves, keep whatever is already there
+    off_t size = lseek(cart->save_fd, 0, SEEK_END);
+    if (size < cart->ram_size && ftruncate(cart->save_fd, cart->ram_size) != 0) {
+        fprintf(stderr, "Error: Couldn't resize save %s\n", save_path);
+        close(cart->save_fd);
+        cart->save_fd = -1;
+        return false;
+    }
+
+    cart->ram = mmap(NULL, cart->ram_size, PROT_READ | PROT_WRITE, MAP_SHARED, cart->save_fd, 0);
+    if (cart->ram == MAP_FAILED) {
+        fprintf(stderr, "Error: Couldn't map save %s\n", save_path);
+        cart->ram = NULL;
+        close(cart->save_fd);
+        cart->save_fd = -1;
+        return false;
+    }
+
+    printf("Save: %s\n", save_path);
+    return true;
+}
+
 void cart_initialize(Cart* cart) {
-    memset(cart->data, 0, CART_SIZE);
+    memset(cart, 0, sizeof(Cart));
+    cart->save_fd = -1;
 }
 
-void cart_load(Cart* cart, const char* path) {
-    FILE* file = fopen(path, "rb");
-    if (file == NULL) {
+bool cart_load(Cart* cart, const char* path, bool save) {
+    cart->rom = rom_open(path);
+    if (cart->rom == NULL) {
         fprintf(stderr, "Error: Couldn't open file %s\n", path);
-        exit(1);
+        return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    cart->size = ftell(file);
-    rewind(file);
+    cart->data = cart->rom->data;
+    cart->size = cart->rom->size;
+    cart_parse_type(cart);
+
+    // without saving, battery ram starts blank like any other
+    if (cart->ram_size > 0) {
+        if (cart->battery && save) {
+            if (!cart_open_save(cart, path)) {
+                return false;
+            }
+        } else {
+            cart->ram = calloc(1, cart->ram_size);
+            if (cart->ram == NULL) {
+                fprintf(stderr, "Error: Couldn't allocate cart ram\n");
+                return false;
+            }
+        }
+    }
 
-    fread(cart->data, cart->size, 1, file);
+    cart->save_time = cart_ticks();
+    return true;
+}
 
+void cart_describe(Cart* cart, const char* path) {
     char title[17];
     memcpy(title, cart->data + 0x134, 16);
     printf("Title: %s\n", title);
@@ -33,5 +146,113 @@ void cart_load(Cart* cart, const char* path) {
     printf("Licensee: %2.2X\n", licensee[0]);
 
     printf("Loaded %ld bytes from %s\n", cart->size, path);
-    fclose(file);
+}
+
+void cart_close(Cart* cart) {
+    if (cart->rom != NULL) {
+        rom_release(cart->rom);
+        cart->rom = NULL;
+        cart->data = NULL;
+    }
+
+    if (cart->ram == NULL) {
+        return;
+    }
+
+    if (cart->save_fd >= 0) {
+        cart_flush(cart, true);
+        munmap(cart->ram, cart->ram_size);
+        close(cart->save_fd);
+        cart->save_fd = -1;
+    } else {
+        free(cart->ram);
+    }
+
+    cart->ram = NULL;
+}
+
+void cart_control(Cart* cart, uint16_t address, uint8_t value) {
+    if (address < 0x2000) {
+        // ram enable
+        if (cart->mbc != 0) {
+            cart->ram_enabled = (value & 0x0F) == 0x0A;
+        }
+    } else if (address >= 0x4000 && address < 0x6000) {
+        // ram bank select
+        if (cart->mbc == 1) {
+            cart->ram_bank = value & 0x03;
+        } else if (cart->mbc == 3) {
+            cart->ram_bank = value; // 0x08-0x0C select the rtc, which is unmapped
+        } else if (cart->mbc == 5) {
+            cart->ram_bank = value & 0x0F;
+        }
+    } else if (address >= 0x6000 && cart->mbc == 1) {
+        // banking mode, ram banks only switch in mode 1
+        cart->mbc1_mode = value & 0x01;
+    }
+}
+
+static long cart_ram_offset(Cart* cart, uint16_t address) {
+    int bank = (cart->mbc == 1 && !cart->mbc1_mode) ? 0 : cart->ram_bank;
+    return ((long)bank * CART_RAM_BANK_SIZE + (address - 0xA000)) % cart->ram_size;
+}
+
+uint8_t* cart_ram_bank(Cart* cart) {
+    // small or unbanked ram (and the mbc3 rtc) can't back a whole page
+    if (cart->ram == NULL || !cart->ram_enabled || cart->ram_size < CART_RAM_BANK_SIZE || cart->mbc == 2) {
+        return NULL;
+    }
+
+    if (cart->mbc == 3 && cart->ram_bank > 0x03) {
+        return NULL;
+    }
+
+    return cart->ram + cart_ram_offset(cart, 0xA000);
+}
+
+uint8_t cart_ram_read(Cart* cart, uint16_t address) {
+    if (cart->ram == NULL || !cart->ram_enabled || (cart->mbc == 3 && cart->ram_bank > 0x03)) {
+        return 0xFF;
+    }
+
+    if (cart->mbc == 2) {
+        return cart->ram[(address - 0xA000) % cart->ram_size] | 0xF0;
+    }
+
+    return cart->ram[cart_ram_offset(cart, address)];
+}
+
+void cart_ram_write(Cart* cart, uint16_t address, uint8_t value) {
+    if (cart->ram == NULL || !cart->ram_enabled || (cart->mbc == 3 && cart->ram_bank > 0x03)) {
+        return;
+    }
+
+    if (cart->mbc == 2) {
+        cart->ram[(address - 0xA000) % cart->ram_size] = value & 0x0F;
+    } else {
+        cart->ram[cart_ram_offset(cart, address)] = value;
+    }
+
+    cart->ram_dirty = true;
+}
+
+bool cart_flush(Cart* cart, bool force) {
+    if (cart->save_fd < 0 || !cart->ram_dirty) {
+        return false;
+    }
+
+    uint64_t now = cart_ticks();
+    if (!force && now - cart->save_time < CART_SAVE_INTERVAL) {
+        return false;
+    }
+
+    // the mapping is shared, so a crash of the emulator itself keeps
+    // everything. msync only schedules the write back here, so it never
+    // blocks the emulation thread but doesn't bound what an os crash or
+    // power loss can lose - only the forced flush on close waits for it
+    msync(cart->ram, cart->ram_size, force ? MS_SYNC : MS_ASYNC);
+    cart->ram_dirty = false;
+    cart->save_time = now;
+
+    return true;
 }
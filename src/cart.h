@@ -3,15 +3,44 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "rom.h"
 
-#define CART_SIZE 0xFFFF
+#define CART_RAM_BANK_SIZE 0x2000
+#define CART_SAVE_INTERVAL 1000 // ms between save flushes
 
 typedef struct cart {
-    uint8_t data[CART_SIZE];
+    // rom shared with other instances, never written
+    Rom* rom;
+    const uint8_t* data;
     long size;
+
+    // header
+    uint8_t type;
+    uint8_t mbc;
+    bool cgb;
+    bool battery;
+
+    // external ram
+    uint8_t* ram;
+    long ram_size;
+    int ram_bank;
+    bool ram_enabled;
+    bool mbc1_mode;
+
+    // battery save
+    int save_fd;
+    bool ram_dirty;
+    uint64_t save_time;
 } Cart;
 
 void cart_initialize(Cart* cart);
-void cart_load(Cart* cart, const char* filename);
+bool cart_load(Cart* cart, const char* filename, bool save);
+void cart_describe(Cart* cart, const char* filename);
+void cart_close(Cart* cart);
+void cart_control(Cart* cart, uint16_t address, uint8_t value);
+uint8_t* cart_ram_bank(Cart* cart);
+uint8_t cart_ram_read(Cart* cart, uint16_t address);
+void cart_ram_write(Cart* cart, uint16_t address, uint8_t value);
+bool cart_flush(Cart* cart, bool force);
 
 #endif
@@ -6,9 +6,20 @@
 #include "mmu.h"
 #include "ppu.h"
 
+// the last operation that set the flags
+typedef enum {
+    FLAGS_F,     // flags_a holds f itself
+    FLAGS_ADD,
+    FLAGS_SUB,
+    FLAGS_INC,
+    FLAGS_DEC,
+    FLAGS_LOGIC, // n and h clear
+    FLAGS_BIT,   // n clear, h set
+} FlagsOp;
+
 typedef struct cpu {
-    // 8-bit registers
-    uint8_t a, f;
+    // 8-bit registers, f is built from the lazy flags below when read
+    uint8_t a;
     uint8_t b, c;
     uint8_t d, e;
     uint8_t h, l;
@@ -17,17 +28,30 @@ typedef struct cpu {
     uint16_t pc; // program counter
     uint16_t sp; // stack pointer
 
+    // lazy flags - z and c are kept directly, n and h are derived from
+    // the operands only when something reads all of f
+    uint8_t flags_op;
+    uint8_t flags_a, flags_b;
+    uint8_t flags_result; // z is set when this is 0
+    uint8_t flags_carry;
+
     // clocks
     uint64_t m, t;
 
     // cycles
     unsigned int cycles;
 
+    // step the bus and ppu per m-cycle instead of per instruction
+    bool accurate;
+
     // debug
     bool debug;
 } CPU;
 
 void cpu_initialize(CPU* cpu);
+void cpu_fast_boot(CPU* cpu, bool cgb);
+uint8_t cpu_flags(CPU* cpu);
+void cpu_set_flags(CPU* cpu, uint8_t f);
 int cpu_cycle(CPU* cpu, MMU* mmu, PPU* ppu);
 
 #endif
@@ -0,0 +1,492 @@
+// instruction set, included once per core by cpu.c
+//
+// the including file defines
+//   CORE_NAME    name of the step function
+//   CORE_TICK()  one m-cycle on the bus, empty for the fast core
+//
+// memory goes through READ/WRITE so each access can take its m-cycle,
+// IDLE marks the internal cycles between them
+
+#ifndef CORE_FUNCTION
+#define CORE_CONCAT(a, b) a##_##b
+#define CORE_EXPAND(a, b) CORE_CONCAT(a, b)
+#define CORE_FUNCTION(name) CORE_EXPAND(CORE_NAME, name)
+#endif
+
+#define READ(address) (CORE_TICK(), mmu_read(mmu, (address)))
+#define WRITE(address, value) do { CORE_TICK(); mmu_write(mmu, (address), (value)); } while (0)
+#define IDLE() CORE_TICK()
+
+// low byte first on reads, high byte first on writes like the stack does
+#define READ16(address) CORE_FUNCTION(read16)(cpu, mmu, ppu, (address))
+#define WRITE16(address, value) CORE_FUNCTION(write16)(cpu, mmu, ppu, (address), (value))
+
+static inline uint16_t CORE_FUNCTION(read16)(CPU* cpu, MMU* mmu, PPU* ppu, uint16_t address) {
+    uint8_t low = READ(address);
+    uint8_t high = READ(address + 1);
+    return low | (high << 8);
+}
+
+static inline void CORE_FUNCTION(write16)(CPU* cpu, MMU* mmu, PPU* ppu, uint16_t address, uint16_t value) {
+    WRITE(address + 1, value >> 8);
+    WRITE(address, value & 0xFF);
+}
+
+static int CORE_NAME(CPU* cpu, MMU* mmu, PPU* ppu) {
+    cpu_debug(cpu);
+
+    uint8_t opcode = READ(cpu->pc);
+
+    DEBUG_PRINT(("Opcode:\n0x%02X\n\n", opcode));
+    DEBUG_PRINT(("$%04X: ", cpu->pc));
+
+    cpu->pc += 1;
+    int cycles = 0;
+
+    switch (opcode) {
+        case 0x00: // NOP
+            DEBUG_PRINT(("NOP"));
+            cycles = 4;
+            break;
+        case 0x04: // INC B
+            DEBUG_PRINT(("INC B"));
+            flags_inc(cpu, cpu->b);
+            cpu->b += 1;
+            cycles = 4;
+            break;
+        case 0x05: // DEC B
+            DEBUG_PRINT(("DEC B"));
+            flags_dec(cpu, cpu->b);
+            cpu->b -= 1;
+            cycles = 4;
+            break;
+        case 0x06: // LD B,n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD B,$%02X", n));
+                cpu->b = n;
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        case 0x0C: // INC C
+            DEBUG_PRINT(("INC C"));
+            flags_inc(cpu, cpu->c);
+            cpu->c += 1;
+            cycles = 4;
+            break;
+        case 0x0D: // DEC C
+            DEBUG_PRINT(("DEC C"));
+            flags_dec(cpu, cpu->c);
+            cpu->c -= 1;
+            cycles = 4;
+            break;
+        case 0x0E: // LD C,n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD C,$%02X", n));
+                cpu->c = n;
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        case 0x10: // STOP
+            DEBUG_PRINT(("STOP"));
+            cpu->pc += 1;
+            if (mmu_speed_switch(mmu)) {
+                DEBUG_PRINT((" (speed switch)"));
+            }
+            cycles = 4;
+            break;
+        case 0x11: // LD DE,nn
+            {
+                uint16_t nn = READ16(cpu->pc);
+                DEBUG_PRINT(("LD DE,$%04X", nn));
+                set_de(cpu, nn);
+                cpu->pc += 2;
+                cycles = 12;
+            }
+            break;
+        case 0x13: // INC DE
+            {
+                DEBUG_PRINT(("INC DE"));
+                uint16_t de = get_de(cpu) + 1;
+                set_de(cpu, de);
+                IDLE();
+                cycles = 8;
+            }
+            break;
+        case 0x15: // DEC D
+            DEBUG_PRINT(("DEC D"));
+            flags_dec(cpu, cpu->d);
+            cpu->d -= 1;
+            cycles = 4;
+            break;
+        case 0x16: // LD D,n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD D,$%02X", n));
+                cpu->d = n;
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        case 0x17: // RLA
+            DEBUG_PRINT(("RLA"));
+            {
+                uint8_t carry = cpu->flags_carry;
+                cpu_set_flags(cpu, (cpu->a & 0x80) >> 3);
+                cpu->a = (cpu->a << 1) | carry;
+            }
+            cycles = 4;
+            break;
+        case 0x18: // JR n
+            {
+                int8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("JR %d", n));
+                cpu->pc += 1;
+                cpu->pc += n;
+                IDLE();
+                cycles = 12;
+            }
+            break;
+        case 0x1A: // LD A,(DE)
+            DEBUG_PRINT(("LD A,(DE)"));
+            cpu->a = READ(get_de(cpu));
+            cycles = 8;
+            break;
+        case 0x1D: // DEC E
+            DEBUG_PRINT(("DEC E"));
+            flags_dec(cpu, cpu->e);
+            cpu->e -= 1;
+            cycles = 4;
+            break;
+        case 0x1E: // LD E,n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD E,$%02X", n));
+                cpu->e = n;
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        case 0x20: // JR NZ,n
+            {
+                int8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("JR NZ,%d", n));
+                cpu->pc += 1;
+                cycles = 8;
+                if (cpu->flags_result != 0) {
+                    cpu->pc += n;
+                    IDLE();
+                    cycles = 12;
+                }
+            }
+            break;
+        case 0x21: // LD HL,nn
+            {
+                uint16_t nn = READ16(cpu->pc);
+                DEBUG_PRINT(("LD HL,$%04X", nn));
+                set_hl(cpu, nn);
+                cpu->pc += 2;
+                cycles = 12;
+            }
+            break;
+        case 0x22: // LD (HL+),A
+            DEBUG_PRINT(("LD (HL+),A"));
+            {
+                uint16_t hl = get_hl(cpu);
+                WRITE(hl, cpu->a);
+                set_hl(cpu, hl + 1);
+                cycles = 8;
+            }
+            break;
+        case 0x23: // INC HL
+            DEBUG_PRINT(("INC HL"));
+            set_hl(cpu, get_hl(cpu) + 1);
+            IDLE();
+            cycles = 8;
+            break;
+        case 0x24: // INC H
+            DEBUG_PRINT(("INC H"));
+            flags_inc(cpu, cpu->h);
+            cpu->h += 1;
+            cycles = 4;
+            break;
+        case 0x27: // DAA
+            DEBUG_PRINT(("DAA"));
+            {
+                // reads n, h and c from the last add or subtract
+                uint8_t f = cpu_flags(cpu);
+                uint8_t correction = 0;
+                bool carry = f & 0x10;
+                if ((f & 0x20) || (!(f & 0x40) && (cpu->a & 0x0F) > 0x09)) {
+                    correction |= 0x06;
+                }
+                if (carry || (!(f & 0x40) && cpu->a > 0x99)) {
+                    correction |= 0x60;
+                    carry = true;
+                }
+                cpu->a = (f & 0x40) ? cpu->a - correction : cpu->a + correction;
+                cpu_set_flags(cpu, (cpu->a == 0 ? 0x80 : 0) | (f & 0x40) | (carry ? 0x10 : 0));
+            }
+            cycles = 4;
+            break;
+        case 0x28: // JR Z,n
+            {
+                int8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("JR Z,%d", n));
+                cpu->pc += 1;
+                cycles = 8;
+                if (cpu->flags_result == 0) {
+                    cpu->pc += n;
+                    IDLE();
+                    cycles = 12;
+                }
+            }
+            break;
+        case 0x2E: // LD L,n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD L,$%02X", n));
+                cpu->l = n;
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        case 0x31: // LD SP,nn
+            {
+                uint16_t nn = READ16(cpu->pc);
+                DEBUG_PRINT(("LD SP,$%04X", nn));
+                cpu->sp = nn;
+                cpu->pc += 2;
+                cycles = 12;
+            }
+            break;
+        case 0x32: // LDD (HL),A
+            DEBUG_PRINT(("LD (HL-),A"));
+            {
+                uint16_t hl = get_hl(cpu);
+                WRITE(hl, cpu->a);
+                set_hl(cpu, hl - 1);
+                cycles = 8;
+            }
+            break;
+        case 0x3D: // DEC A
+            DEBUG_PRINT(("DEC A"));
+            flags_dec(cpu, cpu->a);
+            cpu->a -= 1;
+            cycles = 4;
+            break;
+        case 0x3E: // LD A,n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD A,$%02X", n));
+                cpu->a = n;
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        case 0x4F: // LD C,A
+            DEBUG_PRINT(("LD C,A"));
+            cpu->c = cpu->a;
+            cycles = 4;
+            break;
+        case 0x57: // LD D,A
+            DEBUG_PRINT(("LD D,A"));
+            cpu->d = cpu->a;
+            cycles = 4;
+            break;
+        case 0x5F: // LD E,A
+            DEBUG_PRINT(("LD E,A"));
+            cpu->e = cpu->a;
+            cycles = 4;
+            break;
+        case 0x67: // LD H,A
+            DEBUG_PRINT(("LD H,A"));
+            cpu->h = cpu->a;
+            cycles = 4;
+            break;
+        case 0x77: // LD (HL),A
+            DEBUG_PRINT(("LD (HL),A"));
+            WRITE(get_hl(cpu), cpu->a);
+            cycles = 8;
+            break;
+        case 0x78: // LD A,B
+            DEBUG_PRINT(("LD A,B"));
+            cpu->a = cpu->b;
+            cycles = 4;
+            break;
+        case 0x7B: // LD A,E
+            DEBUG_PRINT(("LD A,E"));
+            cpu->a = cpu->e;
+            cycles = 4;
+            break;
+        case 0x7C: // LD A,H
+            DEBUG_PRINT(("LD A,H"));
+            cpu->a = cpu->h;
+            cycles = 4;
+            break;
+        case 0x7D: // LD A,L
+            DEBUG_PRINT(("LD A,L"));
+            cpu->a = cpu->l;
+            cycles = 4;
+            break;
+        case 0x86: // ADD A,(HL)
+            DEBUG_PRINT(("ADD A,(HL)"));
+            {
+                uint8_t n = READ(get_hl(cpu));
+                flags_add(cpu, cpu->a, n);
+                cpu->a = cpu->flags_result;
+            }
+            cycles = 8;
+            break;
+        case 0x90: // SUB B
+            DEBUG_PRINT(("SUB B"));
+            flags_sub(cpu, cpu->a, cpu->b);
+            cpu->a = cpu->flags_result;
+            cycles = 4;
+            break;
+        case 0xAF: // XOR A
+            DEBUG_PRINT(("XOR A"));
+            cpu->a ^= cpu->a;
+            flags_logic(cpu, cpu->a, 0);
+            cycles = 4;
+            break;
+        case 0xBE: // CP (HL)
+            DEBUG_PRINT(("CP (HL)"));
+            {
+                uint8_t n = READ(get_hl(cpu));
+                flags_sub(cpu, cpu->a, n);
+            }
+            cycles = 8;
+            break;
+        case 0xC1: // POP BC
+            DEBUG_PRINT(("POP BC"));
+            set_bc(cpu, READ16(cpu->sp));
+            cpu->sp += 2;
+            cycles = 12;
+            break;
+        case 0xC5: // PUSH BC
+            DEBUG_PRINT(("PUSH BC"));
+            cpu->sp -= 2;
+            IDLE();
+            WRITE16(cpu->sp, get_bc(cpu));
+            cycles = 16;
+            break;
+        case 0xC9: // RET
+            DEBUG_PRINT(("RET"));
+            cpu->pc = READ16(cpu->sp);
+            cpu->sp += 2;
+            IDLE();
+            cycles = 16;
+            break;
+        case 0xCB: // Bit Instructions
+            opcode = READ(cpu->pc);
+            cpu->pc += 1;
+            switch (opcode) {
+                case 0x11: // RL C
+                    DEBUG_PRINT(("RL C"));
+                    {
+                        uint8_t carry = cpu->flags_carry;
+                        uint8_t carry_out = cpu->c >> 7;
+                        cpu->c = (cpu->c << 1) | carry;
+                        flags_logic(cpu, cpu->c, carry_out);
+                    }
+                    cycles = 8;
+                    break;
+                case 0x7C: // BIT 7,H
+                    DEBUG_PRINT(("BIT 7,H"));
+                    cpu->flags_op = FLAGS_BIT;
+                    cpu->flags_result = cpu->h & 0x80;
+                    cycles = 8;
+                    break;
+                default:
+                    fprintf(stderr, "Unknown opcode: 0xCB%X\n", opcode);
+                    exit(EXIT_FAILURE);
+            }
+            break;
+        case 0xCD: // CALL nn
+            {
+                uint16_t address = READ16(cpu->pc);
+                DEBUG_PRINT(("CALL $%04X", address));
+                cpu->pc += 2;
+                cpu->sp -= 2;
+                IDLE();
+                WRITE16(cpu->sp, cpu->pc);
+                cpu->pc = address;
+                cycles = 24;
+            }
+            break;
+        case 0xE0: // LD (n),A
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD ($FF%02X),A", n));
+                WRITE(0xFF00 + n, cpu->a);
+                cpu->pc += 1;
+                cycles = 12;
+            }
+            break;
+        case 0xE2: // LD (C),A
+            DEBUG_PRINT(("LD ($FF%02X),A", cpu->c));
+            WRITE(0xFF00 + cpu->c, cpu->a);
+            cycles = 8;
+            break;
+        case 0xEA: // LD (nn),A
+            {
+                uint16_t nn = READ16(cpu->pc);
+                DEBUG_PRINT(("LD ($%04X),A", nn));
+                WRITE(nn, cpu->a);
+                cpu->pc += 2;
+                cycles = 16;
+            }
+            break;
+        case 0xF0: // LD A,(n)
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("LD A,($FF%02X)", n));
+                DEBUG_PRINT(("\nAT $%04X = $%02X\n", 0xFF00 + n, mmu_read(mmu, 0xFF00 + n)));
+                cpu->a = READ(0xFF00 + n);
+                cpu->pc += 1;
+                cycles = 12;
+            }
+            break;
+        case 0xF1: // POP AF
+            DEBUG_PRINT(("POP AF"));
+            set_af(cpu, READ16(cpu->sp));
+            cpu->sp += 2;
+            cycles = 12;
+            break;
+        case 0xF5: // PUSH AF
+            DEBUG_PRINT(("PUSH AF"));
+            cpu->sp -= 2;
+            IDLE();
+            WRITE16(cpu->sp, get_af(cpu));
+            cycles = 16;
+            break;
+        case 0xFE: // CP n
+            {
+                uint8_t n = READ(cpu->pc);
+                DEBUG_PRINT(("CP $%02X", n));
+                flags_sub(cpu, cpu->a, n);
+                cpu->pc += 1;
+                cycles = 8;
+            }
+            break;
+        default:
+            fprintf(stderr, "Unknown opcode: 0x%X\n", opcode);
+            exit(EXIT_FAILURE);
+    }
+
+    cpu->cycles += cycles;
+
+    return cycles;
+}
+
+#undef READ
+#undef WRITE
+#undef IDLE
+#undef READ16
+#undef WRITE16
+#undef CORE_NAME
+#undef CORE_TICK
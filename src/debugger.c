@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debugger.h"
+#include "gameboy.h"
+
+// points only cost anything on the pages they cover - read and write
+// points take their pages out of the mmu's fast map, execute points make
+// gb_run_frame check pc before each instruction
+
+void debugger_initialize(Debugger* debugger) {
+    memset(debugger, 0, sizeof(Debugger));
+    debugger->next_id = 1;
+}
+
+static void debugger_update(Debugger* debugger) {
+    uint16_t watch_read = 0;
+    uint16_t watch_write = 0;
+    debugger->exec = false;
+
+    for (int i = 0; i < debugger->count; i++) {
+        DebugPoint* point = &debugger->points[i];
+        uint16_t pages = 0;
+        for (int page = point->start >> MMU_PAGE_SHIFT; page <= point->end >> MMU_PAGE_SHIFT; page++) {
+            pages |= 1 << page;
+        }
+
+        if (point->type & DEBUG_READ) {
+            watch_read |= pages;
+        }
+        if (point->type & DEBUG_WRITE) {
+            watch_write |= pages;
+        }
+        if (point->type & DEBUG_EXEC) {
+            debugger->exec = true;
+        }
+    }
+
+    if (debugger->gb != NULL) {
+        MMU* mmu = &debugger->gb->mmu;
+        mmu->watch_read = watch_read;
+        mmu->watch_write = watch_write;
+        mmu_remap(mmu);
+    }
+}
+
+void debugger_attach(Debugger* debugger, struct gameboy* gb) {
+    debugger->gb = gb;
+    gb->mmu.debugger = debugger;
+    debugger_update(debugger);
+}
+
+bool debugger_add(Debugger* debugger, uint8_t type, uint16_t start, uint16_t end, bool match, uint8_t value, uint32_t count) {
+    if (debugger->count == DEBUG_POINTS || end < start) {
+        return false;
+    }
+
+    DebugPoint* point = &debugger->points[debugger->count++];
+    point->id = debugger->next_id++;
+    point->type = type;
+    point->start = start;
+    point->end = end;
+    point->match = match;
+    point->value = value;
+    point->count = count > 0 ? count : 1;
+    point->hits = 0;
+
+    debugger_update(debugger);
+    return true;
+}
+
+bool debugger_remove(Debugger* debugger, int id) {
+    for (int i = 0; i < debugger->count; i++) {
+        if (debugger->points[i].id == id) {
+            debugger->points[i] = debugger->points[--debugger->count];
+            debugger_update(debugger);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void debugger_hit(Debugger* debugger, DebugPoint* point, uint16_t address, uint8_t value, uint8_t access) {
+    if (point->match && value != point->value) {
+        return;
+    }
+
+    // stop on the count'th hit and every one after it
+    if (++point->hits < point->count || debugger->stopped) {
+        return;
+    }
+
+    debugger->stopped = true;
+    debugger->hit = point->id;
+    debugger->address = address;
+    debugger->value = value;
+    debugger->access = access;
+}
+
+void debugger_access(Debugger* debugger, uint16_t address, uint8_t value, uint8_t access) {
+    for (int i = 0; i < debugger->count; i++) {
+        DebugPoint* point = &debugger->points[i];
+        if ((point->type & access) && address >= point->start && address <= point->end) {
+            debugger_hit(debugger, point, address, value, access);
+        }
+    }
+}
+
+bool debugger_exec(Debugger* debugger, uint16_t pc) {
+    if (!debugger->exec) {
+        return debugger->stopped;
+    }
+
+    if (debugger->resume) {
+        debugger->resume = false;
+        if (pc == debugger->resume_pc) {
+            return false;
+        }
+    }
+
+    uint8_t opcode = mmu_peek(&debugger->gb->mmu, pc);
+    for (int i = 0; i < debugger->count; i++) {
+        DebugPoint* point = &debugger->points[i];
+        if ((point->type & DEBUG_EXEC) && pc >= point->start && pc <= point->end) {
+            debugger_hit(debugger, point, pc, opcode, DEBUG_EXEC);
+        }
+    }
+
+    if (debugger->stopped) {
+        debugger->resume = true;
+        debugger->resume_pc = pc;
+    }
+
+    return debugger->stopped;
+}
+
+void debugger_stop(Debugger* debugger) {
+    debugger->stopped = true;
+    debugger->hit = 0;
+}
+
+static const char* debugger_type_name(uint8_t type) {
+    switch (type) {
+        case DEBUG_READ: return "read";
+        case DEBUG_WRITE: return "write";
+        case DEBUG_READ | DEBUG_WRITE: return "access";
+        default: return "exec";
+    }
+}
+
+static void debugger_registers(Debugger* debugger) {
+    GameBoy* gb = debugger->gb;
+    CPU* cpu = &gb->cpu;
+    uint8_t f = cpu_flags(cpu);
+    printf("AF %02X%02X  BC %02X%02X  DE %02X%02X  HL %02X%02X  SP %04X  PC %04X  [%c%c%c%c]\n",
+           cpu->a, f, cpu->b, cpu->c, cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp, cpu->pc,
+           f & 0x80 ? 'Z' : '-', f & 0x40 ? 'N' : '-', f & 0x20 ? 'H' : '-', f & 0x10 ? 'C' : '-');
+    printf("LY %d  frame %u  clock %llu  next %02X\n", gb->ppu.scanline, gb->ppu.frame,
+           (unsigned long long)gb->mmu.clock, mmu_peek(&gb->mmu, cpu->pc));
+}
+
+static void debugger_report(Debugger* debugger) {
+    if (debugger->hit == 0) {
+        printf("Stopped\n");
+    } else if (debugger->access == DEBUG_EXEC) {
+        printf("Breakpoint %d at $%04X\n", debugger->hit, debugger->address);
+    } else {
+        printf("Watchpoint %d: %s $%04X = $%02X\n", debugger->hit, debugger_type_name(debugger->access), debugger->address, debugger->value);
+    }
+    debugger_registers(debugger);
+}
+
+static bool debugger_parse_range(const char* text, uint16_t* start, uint16_t* end) {
+    // $C000, C000 or C000-C0FF
+    if (text == NULL) {
+        return false;
+    }
+
+    char* rest;
+    *start = strtoul(text + (text[0] == '$'), &rest, 16);
+    *end = *start;
+    if (*rest == '-') {
+        rest++;
+        *end = strtoul(rest + (rest[0] == '$'), &rest, 16);
+    }
+
+    return *rest == '\0';
+}
+
+static void debugger_add_command(Debugger* debugger, uint8_t type) {
+    uint16_t start, end;
+    if (!debugger_parse_range(strtok(NULL, " \t\n"), &start, &end)) {
+        printf("Expected an address or range like C000-C0FF\n");
+        return;
+    }
+
+    // optional conditions
+    bool match = false;
+    uint8_t value = 0;
+    uint32_t count = 1;
+    char* word;
+    while ((word = strtok(NULL, " \t\n")) != NULL) {
+        char* argument = strtok(NULL, " \t\n");
+        if (argument == NULL) {
+            printf("Missing a value after %s\n", word);
+            return;
+        }
+        if (strcmp(word, "value") == 0) {
+            match = true;
+            value = strtoul(argument + (argument[0] == '$'), NULL, 16);
+        } else if (strcmp(word, "hits") == 0) {
+            count = strtoul(argument, NULL, 10);
+        } else {
+            printf("Unknown condition %s\n", word);
+            return;
+        }
+    }
+
+    if (!debugger_add(debugger, type, start, end, match, value, count)) {
+        printf("Could not add the point\n");
+        return;
+    }
+
+    printf("%s %d: $%04X-$%04X\n", type == DEBUG_EXEC ? "Breakpoint" : "Watchpoint", debugger->next_id - 1, start, end);
+}
+
+static void debugger_list(Debugger* debugger) {
+    if (debugger->count == 0) {
+        printf("No points\n");
+    }
+
+    for (int i = 0; i < debugger->count; i++) {
+        DebugPoint* point = &debugger->points[i];
+        printf("%d: %s $%04X-$%04X", point->id, debugger_type_name(point->type), point->start, point->end);
+        if (point->match) {
+            printf(" value $%02X", point->value);
+        }
+        if (point->count > 1) {
+            printf(" hits %u", point->count);
+        }
+        printf(" (hit %u)\n", point->hits);
+    }
+}
+
+static void debugger_memory(Debugger* debugger) {
+    uint16_t start, end;
+    if (!debugger_parse_range(strtok(NULL, " \t\n"), &start, &end)) {
+        printf("Expected an address or range like C000-C0FF\n");
+        return;
+    }
+    if (end == start) {
+        // a default of 64 bytes, stopping at the top of memory
+        end = start > 0xFFC0 ? 0xFFFF : start + 0x3F;
+    }
+
+    for (uint32_t address = start; address <= end; address++) {
+        if (address == start || address % 16 == 0) {
+            printf("%s%04X:", address == start ? "" : "\n", address);
+        }
+        printf(" %02X", mmu_peek(&debugger->gb->mmu, address));
+    }
+    printf("\n");
+}
+
+static void debugger_step(Debugger* debugger, int steps) {
+    // points still fire while stepping, the first instruction is never held back
+    debugger->stopped = false;
+    for (int i = 0; i < steps && !debugger->stopped; i++) {
+        if (i > 0 && debugger_exec(debugger, debugger->gb->cpu.pc)) {
+            break;
+        }
+        debugger->resume = false;
+        gb_step(debugger->gb);
+    }
+
+    if (debugger->stopped) {
+        debugger_report(debugger);
+    } else {
+        debugger_registers(debugger);
+    }
+}
+
+static void debugger_help(void) {
+    printf("break <range> [value <v>] [hits <n>]        stop before executing in range\n");
+    printf("watch r|w|rw <range> [value <v>] [hits <n>] stop after memory access in range\n");
+    printf("delete <id>   list   regs   mem <range>\n");
+    printf("step [n]   continue   quit\n");
+}
+
+bool debugger_console(Debugger* debugger) {
+    debugger_report(debugger);
+
+    char line[256];
+    for (;;) {
+        printf("(gb) ");
+        fflush(stdout);
+
+        // without a console keep running
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            debugger->stopped = false;
+            return true;
+        }
+
+        char* command = strtok(line, " \t\n");
+        if (command == NULL) {
+            continue;
+        }
+
+        if (strcmp(command, "c") == 0 || strcmp(command, "continue") == 0) {
+            debugger->stopped = false;
+            return true;
+        } else if (strcmp(command, "s") == 0 || strcmp(command, "step") == 0) {
+            char* count = strtok(NULL, " \t\n");
+            debugger_step(debugger, count != NULL ? atoi(count) : 1);
+        } else if (strcmp(command, "b") == 0 || strcmp(command, "break") == 0) {
+            debugger_add_command(debugger, DEBUG_EXEC);
+        } else if (strcmp(command, "w") == 0 || strcmp(command, "watch") == 0) {
+            char* mode = strtok(NULL, " \t\n");
+            uint8_t type = 0;
+            if (mode != NULL && strchr(mode, 'r') != NULL) {
+                type |= DEBUG_READ;
+            }
+            if (mode != NULL && strchr(mode, 'w') != NULL) {
+                type |= DEBUG_WRITE;
+            }
+            if (type == 0) {
+                printf("Expected r, w or rw\n");
+            } else {
+                debugger_add_command(debugger, type);
+            }
+        } else if (strcmp(command, "d") == 0 || strcmp(command, "delete") == 0) {
+            char* id = strtok(NULL, " \t\n");
+            if (id == NULL || !debugger_remove(debugger, atoi(id))) {
+                printf("No such point\n");
+            }
+        } else if (strcmp(command, "l") == 0 || strcmp(command, "list") == 0) {
+            debugger_list(debugger);
+        } else if (strcmp(command, "r") == 0 || strcmp(command, "regs") == 0) {
+            debugger_registers(debugger);
+        } else if (strcmp(command, "m") == 0 || strcmp(command, "mem") == 0) {
+            debugger_memory(debugger);
+        } else if (strcmp(command, "q") == 0 || strcmp(command, "quit") == 0) {
+            return false;
+        } else {
+            debugger_help();
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEBUG_POINTS 32
+
+// what a point stops on
+#define DEBUG_READ 0x01
+#define DEBUG_WRITE 0x02
+#define DEBUG_EXEC 0x04
+
+struct gameboy;
+
+typedef struct {
+    int id;
+    uint8_t type;
+    uint16_t start;
+    uint16_t end;
+
+    // conditions - the value read, written or executed, and the hit to stop on
+    bool match;
+    uint8_t value;
+    uint32_t count;
+    uint32_t hits;
+} DebugPoint;
+
+typedef struct debugger {
+    struct gameboy* gb;
+    DebugPoint points[DEBUG_POINTS];
+    int count;
+    int next_id;
+    bool exec; // any execute points, the cpu loop only checks pc when set
+
+    // why the emulator stopped
+    bool stopped;
+    int hit;
+    uint16_t address;
+    uint8_t value;
+    uint8_t access;
+
+    // an execute point that was just reported is passed over once on resume
+    bool resume;
+    uint16_t resume_pc;
+} Debugger;
+
+void debugger_initialize(Debugger* debugger);
+void debugger_attach(Debugger* debugger, struct gameboy* gb);
+bool debugger_add(Debugger* debugger, uint8_t type, uint16_t start, uint16_t end, bool match, uint8_t value, uint32_t count);
+bool debugger_remove(Debugger* debugger, int id);
+void debugger_access(Debugger* debugger, uint16_t address, uint8_t value, uint8_t access);
+bool debugger_exec(Debugger* debugger, uint16_t pc);
+void debugger_stop(Debugger* debugger);
+bool debugger_console(Debugger* debugger);
+
+#endif
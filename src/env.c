@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "env.h"
+#include "gameboy.h"
+#include "snapshot.h"
+#include "pool.h"
+
+// every buffer is allocated once up front - stepping only runs frames and
+// writes each env's slot of the shared observation and ram arrays
+
+struct env_batch {
+    GameBoy** envs;
+    int count;
+    Pool* pool;
+
+    // where every episode starts, and what it looks like there
+    Snapshot* start;
+    uint8_t start_observation[ENV_OBS_SIZE];
+
+    // outputs
+    uint8_t* observations;
+    uint8_t* ram;
+    uint16_t ram_address;
+    int ram_size;
+
+    // the call being run on the pool
+    const uint8_t* actions;
+    const uint8_t* mask;
+    int frames;
+};
+
+static GameBoy* env_boot(const char* rom_path, const char* bios_path) {
+    GameBoy* gb = gb_create();
+    if (gb == NULL) {
+        return NULL;
+    }
+
+    // no saves, no sound, nothing outside the instance - and a boot rom that
+    // was asked for but can't be loaded is an error, not a fast boot
+    if (!gb_load(gb, rom_path, false) || (gb_boot(gb, bios_path, bios_path == NULL) && bios_path != NULL)) {
+        gb_destroy(gb);
+        return NULL;
+    }
+    gb->apu.silent = true;
+    return gb;
+}
+
+static void env_downsample(const uint32_t* display, uint8_t* observation) {
+    for (int y = 0; y < ENV_OBS_HEIGHT; y++) {
+        for (int x = 0; x < ENV_OBS_WIDTH; x++) {
+            const uint32_t* pixel = display + (y * PPU_DISPLAY_WIDTH + x) * ENV_OBS_SCALE;
+            int sum = 0;
+            for (int dy = 0; dy < ENV_OBS_SCALE; dy++) {
+                for (int dx = 0; dx < ENV_OBS_SCALE; dx++) {
+                    // rgba, weighted to luma
+                    uint32_t color = pixel[dy * PPU_DISPLAY_WIDTH + dx];
+                    sum += ((color >> 24) * 77 + ((color >> 16) & 0xFF) * 150 + ((color >> 8) & 0xFF) * 29) >> 8;
+                }
+            }
+            observation[y * ENV_OBS_WIDTH + x] = sum / (ENV_OBS_SCALE * ENV_OBS_SCALE);
+        }
+    }
+}
+
+static void env_observe_ram(EnvBatch* batch, int index) {
+    MMU* mmu = &batch->envs[index]->mmu;
+    uint8_t* ram = batch->ram + (long)index * batch->ram_size;
+    for (int i = 0; i < batch->ram_size; i++) {
+        ram[i] = mmu_read_memory(mmu, batch->ram_address + i);
+    }
+}
+
+EnvBatch* env_create(const char* rom_path, const char* bios_path, int count, int threads, uint16_t ram_address, int ram_size) {
+    if (count < 1 || count > ENV_MAX || ram_size < 0 || ram_address + ram_size > 0x10000) {
+        return NULL;
+    }
+
+    EnvBatch* batch = calloc(1, sizeof(EnvBatch));
+    if (batch == NULL) {
+        return NULL;
+    }
+    batch->ram_address = ram_address;
+    batch->ram_size = ram_size;
+
+    batch->envs = calloc(count, sizeof(GameBoy*));
+    batch->observations = malloc((long)count * ENV_OBS_SIZE);
+    batch->ram = malloc((long)count * ram_size + 1); // never NULL for an empty slice
+    batch->pool = pool_create(threads);
+    if (batch->envs == NULL || batch->observations == NULL || batch->ram == NULL || batch->pool == NULL) {
+        env_destroy(batch);
+        return NULL;
+    }
+
+    // boot once, past the boot rom and up to a drawn frame
+    GameBoy* first = env_boot(rom_path, bios_path);
+    if (first == NULL) {
+        env_destroy(batch);
+        return NULL;
+    }
+    batch->envs[batch->count++] = first;
+    for (int frame = 0; frame < ENV_BOOT_FRAMES && first->mmu.boot_mapped; frame++) {
+        gb_run_frame(first);
+    }
+    gb_run_frame(first);
+
+    batch->start = snapshot_create(first);
+    if (batch->start == NULL) {
+        env_destroy(batch);
+        return NULL;
+    }
+    snapshot_save(batch->start, first);
+    env_downsample(first->ppu.display, batch->start_observation);
+
+    // the rest start from the snapshot instead of booting again
+    for (int i = 1; i < count; i++) {
+        GameBoy* gb = env_boot(rom_path, bios_path);
+        if (gb == NULL) {
+            env_destroy(batch);
+            return NULL;
+        }
+        batch->envs[batch->count++] = gb;
+    }
+
+    env_reset(batch, NULL);
+    return batch;
+}
+
+int env_count(EnvBatch* batch) {
+    return batch->count;
+}
+
+static void env_step_task(void* arg, int start, int end) {
+    EnvBatch* batch = arg;
+
+    for (int i = start; i < end; i++) {
+        GameBoy* gb = batch->envs[i];
+        mmu_set_buttons(&gb->mmu, batch->actions[i]);
+
+        // only the last frame is looked at, the others aren't drawn
+        for (int frame = 0; frame < batch->frames; frame++) {
+            gb->ppu.skip_render = frame < batch->frames - 1;
+            gb_run_frame(gb);
+        }
+
+        env_downsample(gb->ppu.display, batch->observations + (long)i * ENV_OBS_SIZE);
+        env_observe_ram(batch, i);
+    }
+}
+
+void env_step(EnvBatch* batch, const uint8_t* actions, int frames) {
+    if (frames < 1) {
+        return;
+    }
+
+    batch->actions = actions;
+    batch->frames = frames;
+    pool_run(batch->pool, env_step_task, batch, batch->count);
+}
+
+static void env_reset_task(void* arg, int start, int end) {
+    EnvBatch* batch = arg;
+
+    for (int i = start; i < end; i++) {
+        if (batch->mask != NULL && !batch->mask[i]) {
+            continue;
+        }
+
+        snapshot_load(batch->start, batch->envs[i]);
+        memcpy(batch->observations + (long)i * ENV_OBS_SIZE, batch->start_observation, ENV_OBS_SIZE);
+        env_observe_ram(batch, i);
+    }
+}
+
+void env_reset(EnvBatch* batch, const uint8_t* mask) {
+    batch->mask = mask;
+    pool_run(batch->pool, env_reset_task, batch, batch->count);
+}
+
+const uint8_t* env_observations(EnvBatch* batch) {
+    return batch->observations;
+}
+
+const uint8_t* env_ram(EnvBatch* batch) {
+    return batch->ram;
+}
+
+void env_destroy(EnvBatch* batch) {
+    for (int i = 0; i < batch->count; i++) {
+        gb_destroy(batch->envs[i]);
+    }
+
+    if (batch->start != NULL) {
+        snapshot_destroy(batch->start);
+    }
+    if (batch->pool != NULL) {
+        pool_destroy(batch->pool);
+    }
+    free(batch->envs);
+    free(batch->observations);
+    free(batch->ram);
+    free(batch);
+}
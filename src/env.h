@@ -0,0 +1,37 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ppu.h"
+
+// observations are the display averaged down 2x2 to 8-bit grayscale
+#define ENV_OBS_SCALE 2
+#define ENV_OBS_WIDTH (PPU_DISPLAY_WIDTH / ENV_OBS_SCALE)
+#define ENV_OBS_HEIGHT (PPU_DISPLAY_HEIGHT / ENV_OBS_SCALE)
+#define ENV_OBS_SIZE (ENV_OBS_WIDTH * ENV_OBS_HEIGHT)
+
+#define ENV_MAX 4096
+#define ENV_BOOT_FRAMES 600 // the boot rom hands over well within this
+
+typedef struct env_batch EnvBatch;
+
+// count instances of one rom stepped together on a thread pool. bios NULL
+// fast boots, every env starts from the same snapshot taken after boot.
+// NULL if the rom or a requested boot rom can't be loaded
+EnvBatch* env_create(const char* rom_path, const char* bios_path, int count, int threads, uint16_t ram_address, int ram_size);
+int env_count(EnvBatch* batch);
+
+// one byte of JOYPAD_* buttons per env, held for frames frames
+void env_step(EnvBatch* batch, const uint8_t* actions, int frames);
+
+// back to the start snapshot, mask NULL resets every env
+void env_reset(EnvBatch* batch, const uint8_t* mask);
+
+// [count][ENV_OBS_HEIGHT][ENV_OBS_WIDTH] and [count][ram_size], valid until the next step or reset
+const uint8_t* env_observations(EnvBatch* batch);
+const uint8_t* env_ram(EnvBatch* batch);
+
+void env_destroy(EnvBatch* batch);
+
+#endif
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include "gameboy.h"
+#include "debugger.h"
+
+GameBoy* gb_create(void) {
+    // instances live on the heap, the rom itself is shared between them
+    GameBoy* gb = malloc(sizeof(GameBoy));
+    if (gb == NULL) {
+        return NULL;
+    }
+
+    gb_initialize(gb);
+    return gb;
+}
+
+void gb_destroy(GameBoy* gb) {
+    gb_close(gb);
+    free(gb);
+}
+
+void gb_initialize(GameBoy* gb) {
+    cart_initialize(&gb->cart);
+    mmu_initialize(&gb->mmu);
+    cpu_initialize(&gb->cpu);
+    apu_initialize(&gb->apu);
+    serial_initialize(&gb->serial, SERIAL_NONE);
+
+    // the ppu is set up by gb_boot, an instance closed before then has no worker
+    gb->ppu.worker = NULL;
+}
+
+bool gb_load(GameBoy* gb, const char* rom_path, bool save) {
+    if (!cart_load(&gb->cart, rom_path, save)) {
+        return false;
+    }
+
+    mmu_load_cart(&gb->mmu, &gb->cart);
+    return true;
+}
+
+bool gb_boot(GameBoy* gb, const char* bios_path, bool fast_boot) {
+    // without a boot rom start from the state it would leave behind
+    if (!fast_boot && !mmu_load_bios(&gb->mmu, bios_path)) {
+        fast_boot = true;
+    }
+
+    // cgb mode needs the state a cgb boot rom would leave, so only fast boot enables it
+    if (fast_boot && gb->cart.cgb) {
+        mmu_enable_cgb(&gb->mmu);
+    }
+
+    if (fast_boot) {
+        mmu_fast_boot(&gb->mmu);
+        cpu_fast_boot(&gb->cpu, gb->mmu.cgb);
+    }
+
+    ppu_initialize(&gb->ppu, &gb->mmu);
+
+    return fast_boot;
+}
+
+int gb_step(GameBoy* gb) {
+    int cycles = cpu_cycle(&gb->cpu, &gb->mmu, &gb->ppu);
+
+    // the accurate core already moved the bus and ppu with each m-cycle
+    int pending = gb->cpu.accurate ? 0 : cycles;
+
+    // cycles the cpu sat out for a general purpose hdma
+    cycles += gb->mmu.stall;
+    pending += gb->mmu.stall;
+    gb->mmu.stall = 0;
+
+    mmu_cycle(&gb->mmu, pending);
+    serial_cycle(&gb->serial, &gb->mmu, cycles);
+
+    // in double speed the ppu and apu see half the cpu clock
+    int ppu_cycles = gb->mmu.double_speed ? cycles / 2 : cycles;
+    ppu_cycle(&gb->ppu, &gb->mmu, gb->mmu.double_speed ? pending / 2 : pending);
+    apu_cycle(&gb->apu, &gb->mmu, ppu_cycles);
+
+    return cycles;
+}
+
+void gb_run_frame(GameBoy* gb) {
+    // runs up to the start of the next v-blank
+    uint32_t frame = gb->ppu.frame;
+    Debugger* debugger = gb->mmu.debugger;
+
+    // or until a point stops it, the plain loop stays as it was without any
+    if (debugger != NULL && debugger->count > 0) {
+        while (gb->ppu.frame == frame && !debugger->stopped) {
+            if (debugger_exec(debugger, gb->cpu.pc)) {
+                break;
+            }
+            gb_step(gb);
+        }
+        return;
+    }
+
+    while (gb->ppu.frame == frame) {
+        gb_step(gb);
+    }
+}
+
+void gb_close(GameBoy* gb) {
+    ppu_stop_worker(&gb->ppu, &gb->mmu);
+    mmu_flush(&gb->mmu, true);
+    cart_close(&gb->cart);
+    mmu_close(&gb->mmu);
+    serial_close(&gb->serial);
+}
@@ -0,0 +1,31 @@
+#ifndef GAMEBOY_H
+#define GAMEBOY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cart.h"
+#include "cpu.h"
+#include "mmu.h"
+#include "ppu.h"
+#include "apu.h"
+#include "serial.h"
+
+typedef struct gameboy {
+    Cart cart;
+    MMU mmu;
+    CPU cpu;
+    PPU ppu;
+    APU apu;
+    Serial serial;
+} GameBoy;
+
+GameBoy* gb_create(void);
+void gb_destroy(GameBoy* gb);
+void gb_initialize(GameBoy* gb);
+bool gb_load(GameBoy* gb, const char* rom_path, bool save);
+bool gb_boot(GameBoy* gb, const char* bios_path, bool fast_boot);
+int gb_step(GameBoy* gb);
+void gb_run_frame(GameBoy* gb);
+void gb_close(GameBoy* gb);
+
+#endif
@@ -1,38 +1,315 @@
 #include <SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <stdbool.h>
-#include "cart.h"
-#include "cpu.h"
-#include "mmu.h"
-#include "ppu.h"
-#include "apu.h"
+#include "gameboy.h"
+#include "movie.h"
+#include "debugger.h"
+#include "snapshot.h"
+#include "scale.h"
 
 #define SCALE_FACTOR 3
+#define FILTER_THREADS 4
+#define FRAME_SKIP 4
+#define RUN_AHEAD_MAX 4
+#define BIOS_PATH "roms/gb_bios.bin"
+
+static void usage(const char* name) {
+    printf("Usage: %s [options] <file.gb>\n", name);
+    printf("  --fast-boot    skip the boot rom and start at 0x0100\n");
+    printf("  --bios <file>  boot rom to run (default %s)\n", BIOS_PATH);
+    printf("  --accurate     step the bus and ppu every m-cycle instead of every instruction\n");
+    printf("  --debug        start stopped in the debugger console (F12 stops a running game)\n");
+    printf("  --serial-stdout        print serial output\n");
+    printf("  --link-host <socket>   wait for a link cable peer\n");
+    printf("  --link-join <socket>   connect to a link cable peer\n");
+    printf("  --link-quantum <n>     cycles between link syncs (default %d)\n", SERIAL_QUANTUM);
+    printf("  --record <file>        record joypad input to a movie\n");
+    printf("  --replay <file>        replay a movie headless and print its frame hash\n");
+    printf("  --frames <n>           run n frames headless and print their hash\n");
+    printf("  --ppu-thread           rasterize on a second thread\n");
+    printf("  --audio-out <file>     stream audio to a wav file, - for raw pcm on stdout\n");
+    printf("  --audio-rate <hz>      audio sample rate (default %d)\n", APU_SAMPLE_RATE);
+    printf("  --filter <name>        nearest, scale2x, scale3x or xbr2x (tab cycles them)\n");
+    printf("  --scale <n>            window scale (default %d)\n", SCALE_FACTOR);
+    printf("  --filter-threads <n>   threads used to scale frames (default up to %d)\n", FILTER_THREADS);
+    printf("  --run-ahead <n>        show each frame as it will be n frames later (0-%d)\n", RUN_AHEAD_MAX);
+    printf("  --frameskip <n>        most frames in a row left undrawn when running behind (default %d)\n", FRAME_SKIP);
+}
+
+static uint8_t key_button(SDL_Keycode key) {
+    switch (key) {
+        case SDLK_RIGHT: return JOYPAD_RIGHT;
+        case SDLK_LEFT: return JOYPAD_LEFT;
+        case SDLK_UP: return JOYPAD_UP;
+        case SDLK_DOWN: return JOYPAD_DOWN;
+        case SDLK_z: return JOYPAD_A;
+        case SDLK_x: return JOYPAD_B;
+        case SDLK_RSHIFT: return JOYPAD_SELECT;
+        case SDLK_RETURN: return JOYPAD_START;
+        default: return 0;
+    }
+}
+
+static uint64_t frame_hash(uint64_t hash, const uint32_t* display) {
+    // fnv-1a
+    const uint8_t* bytes = (const uint8_t*)display;
+    for (int i = 0; i < PPU_DISPLAY_SIZE * sizeof(uint32_t); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static void run_ahead(GameBoy* gb, Snapshot* snapshot, int frames) {
+    // the real frame is kept but not drawn, the frames after it are drawn and thrown away
+    bool skip = gb->ppu.skip_render;
+    uint32_t skipped = gb->ppu.skipped;
+    gb->ppu.skip_render = true;
+    gb_run_frame(gb);
+    snapshot_save(snapshot, gb);
+    snapshot_private_ram(snapshot, gb);
+
+    gb->apu.silent = true;
+    gb->serial.silent = true;
+    for (int i = 0; i < frames; i++) {
+        gb->ppu.skip_render = skip || i < frames - 1;
+        gb_run_frame(gb);
+    }
+    gb->apu.silent = false;
+    gb->serial.silent = false;
+
+    snapshot_load(snapshot, gb);
+    gb->ppu.skip_render = skip;
+    gb->ppu.skipped = skipped + skip;
+    gb->ppu.drawFlag = !skip;
+}
+
+static void run_frame(GameBoy* gb, Snapshot* snapshot, int ahead) {
+    // the debugger stops in real frames, never ones that get rolled back,
+    // but an attached debugger with nothing set can't stop anything
+    Debugger* debugger = gb->mmu.debugger;
+    if (snapshot == NULL || (debugger != NULL && (debugger->stopped || debugger->count > 0))) {
+        gb_run_frame(gb);
+        return;
+    }
+
+    run_ahead(gb, snapshot, ahead);
+}
+
+static void run_headless(GameBoy* gb, Movie* movie, Debugger* debugger, Snapshot* snapshot, int ahead, uint32_t max_frames) {
+    // nothing throttles to real time here, audio export just keeps up
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint32_t frames = 0;
+
+    // no sdl, input only comes from the movie
+    while (max_frames == 0 || frames < max_frames) {
+        if (debugger->stopped && !debugger_console(debugger)) {
+            break;
+        }
+
+        uint8_t buttons = movie_frame(movie, gb->ppu.frame, 0);
+        if (movie->file != NULL && !movie->playing) {
+            break;
+        }
+
+        mmu_set_buttons(&gb->mmu, buttons);
+        run_frame(gb, snapshot, ahead);
+
+        // a point stopped the frame part way, it finishes after the console
+        if (debugger->stopped) {
+            continue;
+        }
+
+        hash = frame_hash(hash, gb->ppu.display);
+        frames++;
+    }
+
+    printf("Frames: %u\n", frames);
+    printf("Hash: %016llX\n", (unsigned long long)hash);
+    if (gb->apu.writer != NULL) {
+        printf("Samples: %llu\n", (unsigned long long)wav_samples(gb->apu.writer));
+    }
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <file.gb>\n", argv[0]);
+    const char* rom_path = NULL;
+    const char* bios_path = BIOS_PATH;
+    bool fast_boot = false;
+    bool accurate = false;
+    bool debug = false;
+    SerialMode serial_mode = SERIAL_NONE;
+    const char* link_host = NULL;
+    const char* link_join = NULL;
+    int link_quantum = SERIAL_QUANTUM;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    int max_frames = 0;
+    bool ppu_thread = false;
+    const char* audio_path = NULL;
+    int audio_rate = APU_SAMPLE_RATE;
+    int filter = SCALE_NEAREST;
+    int scale = SCALE_FACTOR;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int filter_threads = cores < 1 ? 1 : (cores > FILTER_THREADS ? FILTER_THREADS : cores);
+    int frameskip = FRAME_SKIP;
+    int ahead = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fast-boot") == 0) {
+            fast_boot = true;
+        } else if (strcmp(argv[i], "--accurate") == 0) {
+            accurate = true;
+        } else if (strcmp(argv[i], "--debug") == 0) {
+            debug = true;
+        } else if (strcmp(argv[i], "--bios") == 0 && i + 1 < argc) {
+            bios_path = argv[++i];
+        } else if (strcmp(argv[i], "--serial-stdout") == 0) {
+            serial_mode = SERIAL_STDOUT;
+        } else if (strcmp(argv[i], "--link-host") == 0 && i + 1 < argc) {
+            link_host = argv[++i];
+        } else if (strcmp(argv[i], "--link-join") == 0 && i + 1 < argc) {
+            link_join = argv[++i];
+        } else if (strcmp(argv[i], "--link-quantum") == 0 && i + 1 < argc) {
+            link_quantum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            max_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ppu-thread") == 0) {
+            ppu_thread = true;
+        } else if (strcmp(argv[i], "--audio-out") == 0 && i + 1 < argc) {
+            audio_path = argv[++i];
+        } else if (strcmp(argv[i], "--audio-rate") == 0 && i + 1 < argc) {
+            audio_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = scale_filter_parse(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter-threads") == 0 && i + 1 < argc) {
+            filter_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc) {
+            ahead = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frameskip") == 0 && i + 1 < argc) {
+            frameskip = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && rom_path == NULL) {
+            rom_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (rom_path == NULL || link_quantum <= 0 || max_frames < 0 || filter < 0 || scale < 1 || filter_threads < 1 || frameskip < 0 || ahead < 0 || ahead > RUN_AHEAD_MAX || audio_rate <= 0 || audio_rate > APU_CLOCK || (record_path != NULL && replay_path != NULL)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // frames that get rolled back can't take back what went over the cable
+    if (ahead > 0 && (link_host != NULL || link_join != NULL)) {
+        printf("Run-ahead can't be used with a link cable\n");
         return 1;
     }
 
+    bool headless = replay_path != NULL || max_frames > 0;
+
+    // raw pcm takes over stdout, everything printed goes to stderr instead
+    WavWriter* audio = NULL;
+    if (audio_path != NULL && strcmp(audio_path, "-") == 0) {
+        int fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        audio = wav_open_fd(fd, audio_rate);
+    } else if (audio_path != NULL) {
+        audio = wav_open(audio_path, audio_rate);
+    }
+    if (audio_path != NULL && audio == NULL) {
+        printf("Could not start the audio export\n");
+        return 1;
+    }
+    Movie movie;
+    movie_initialize(&movie);
+
     // Initialize Cart, MMU, CPU, PPU, and APU
-    Cart cart;
-    cart_initialize(&cart);
-    cart_load(&cart, argv[1]);
+    GameBoy* gb = gb_create();
+    if (gb == NULL) {
+        printf("Could not allocate the emulator\n");
+        return 1;
+    }
+    gb->apu.sample_rate = audio_rate;
+    gb->apu.writer = audio;
 
-    MMU mmu;
-    mmu_initialize(&mmu);
-    mmu_load_cart(&mmu, &cart);
-    mmu_load_bios(&mmu, "roms/gb_bios.bin");
+    // movies start from blank cart ram so they replay the same every time
+    bool movie_active = record_path != NULL || replay_path != NULL;
+    if (!gb_load(gb, rom_path, !movie_active)) {
+        return 1;
+    }
+    cart_describe(&gb->cart, rom_path);
+
+    if (replay_path != NULL) {
+        if (!movie_play(&movie, replay_path, &gb->cart)) {
+            return 1;
+        }
+        fast_boot = movie.flags & MOVIE_FAST_BOOT;
+        accurate = movie.flags & MOVIE_ACCURATE;
+    }
+
+    if (gb_boot(gb, bios_path, fast_boot) && !fast_boot) {
+        printf("Falling back to fast boot\n");
+        fast_boot = true;
+    }
+    gb->cpu.accurate = accurate;
+
+    // the cores differ in timing, so movies replay on the one they were recorded with
+    uint8_t movie_flags = (fast_boot ? MOVIE_FAST_BOOT : 0) | (accurate ? MOVIE_ACCURATE : 0);
+    if (record_path != NULL && !movie_record(&movie, record_path, &gb->cart, movie_flags)) {
+        return 1;
+    }
+
+    if (ppu_thread && !ppu_start_worker(&gb->ppu, &gb->mmu)) {
+        printf("Could not start the render thread, rendering inline\n");
+    }
 
-    CPU cpu;
-    cpu_initialize(&cpu);
+    serial_initialize(&gb->serial, serial_mode);
+    if (link_host != NULL && !serial_host(&gb->serial, link_host, link_quantum)) {
+        return 1;
+    }
+    if (link_join != NULL && !serial_join(&gb->serial, link_join, link_quantum)) {
+        return 1;
+    }
 
-    PPU ppu;
-    ppu_initialize(&ppu, &mmu);
+    // nothing is diverted until a point is set, so attaching costs nothing
+    Debugger debugger;
+    debugger_initialize(&debugger);
+    if (debug) {
+        debugger_attach(&debugger, gb);
+        debugger_stop(&debugger);
+    }
 
-    APU apu;
-    apu_initialize(&apu);
+    // run-ahead rolls every frame back to a snapshot taken just before it
+    Snapshot* snapshot = NULL;
+    if (ahead > 0) {
+        snapshot = snapshot_create(gb);
+        if (snapshot == NULL) {
+            printf("Could not allocate the run-ahead snapshot\n");
+            return 1;
+        }
+    }
+
+    if (headless) {
+        run_headless(gb, &movie, &debugger, snapshot, ahead, max_frames);
+        movie_close(&movie);
+        if (snapshot != NULL) {
+            snapshot_destroy(snapshot);
+        }
+        gb_destroy(gb);
+        if (audio != NULL) {
+            wav_close(audio);
+        }
+        return 0;
+    }
 
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
@@ -43,12 +320,12 @@ int main(int argc, char* argv[]) {
     // SDL Audio
     SDL_AudioSpec desiredSpec;
     SDL_AudioSpec obtainedSpec;
-    desiredSpec.freq = 44100;
-    desiredSpec.format = AUDIO_U16SYS;
+    desiredSpec.freq = audio_rate;
+    desiredSpec.format = AUDIO_S16SYS;
     desiredSpec.channels = 1;
     desiredSpec.samples = 2048;
     desiredSpec.callback = audio_callback;
-    desiredSpec.userdata = &apu;
+    desiredSpec.userdata = &gb->apu;
 
     if (SDL_OpenAudio(&desiredSpec, &obtainedSpec) < 0) {
         printf("SDL could not open audio! SDL_Error: %s\n", SDL_GetError());
@@ -58,42 +335,107 @@ int main(int argc, char* argv[]) {
 
     SDL_PauseAudio(0);
 
+    // frames are scaled on the cpu straight into the texture
+    Scaler scaler;
+    if (!scaler_initialize(&scaler, PPU_DISPLAY_WIDTH, PPU_DISPLAY_HEIGHT, scale, filter, filter_threads)) {
+        printf("Could not allocate the scaler\n");
+        SDL_Quit();
+        return 1;
+    }
+    if (scaler.filter != filter) {
+        printf("Scale %d does not fit %s, using nearest\n", scale, scale_filter_name(filter));
+    }
+
     // SDL Video
-    SDL_Window* window = SDL_CreateWindow("Game Boy Emulator", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, PPU_DISPLAY_WIDTH * SCALE_FACTOR, PPU_DISPLAY_HEIGHT * SCALE_FACTOR, SDL_WINDOW_SHOWN);
+    SDL_Window* window = SDL_CreateWindow("Game Boy Emulator", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, scaler.width, scaler.height, SDL_WINDOW_SHOWN);
     SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, PPU_DISPLAY_WIDTH, PPU_DISPLAY_HEIGHT);
-
-    uint32_t pixels[PPU_DISPLAY_WIDTH * PPU_DISPLAY_HEIGHT];
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, scaler.width, scaler.height);
 
     bool quit = false;
+    uint8_t buttons = 0;
     SDL_Event e;
 
+    // frames are paced to the game boy's 59.7hz
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t frame_time = frequency * PPU_FRAME_CYCLES / APU_CLOCK;
+    uint64_t deadline = SDL_GetPerformanceCounter();
+    int skip_run = 0;
+
     while (!quit) {
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)) {
                 quit = true;
+            } else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F12) {
+                debugger_attach(&debugger, gb);
+                debugger_stop(&debugger);
+            } else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_TAB) {
+                scaler_next_filter(&scaler);
+                printf("Filter: %s\n", scale_filter_name(scaler.filter));
+            } else if (e.type == SDL_KEYDOWN) {
+                buttons |= key_button(e.key.keysym.sym);
+            } else if (e.type == SDL_KEYUP) {
+                buttons &= ~key_button(e.key.keysym.sym);
             }
         }
 
-        // CPU cycle
-        int cycles = cpu_cycle(&cpu, &mmu, &ppu);
-
-        for (int i = 0; i < cycles; i++) {
-            ppu_cycle(&ppu, &mmu);
-            apu_cycle(&apu, &mmu);
+        // the console holds the window until the game is continued
+        if (debugger.stopped && !debugger_console(&debugger)) {
+            break;
         }
 
+        // input is latched once per frame so movies can key it by frame
+        mmu_set_buttons(&gb->mmu, movie_frame(&movie, gb->ppu.frame, buttons));
+        run_frame(gb, snapshot, ahead);
+
         // PPU signal
-        if (ppu.drawFlag) {
-            for (int i = 0; i < PPU_DISPLAY_WIDTH * PPU_DISPLAY_HEIGHT; ++i) {
-                pixels[i] = ppu.display[i];
+        if (gb->ppu.drawFlag) {
+            void* pixels;
+            int pitch;
+            if (SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
+                scaler_run(&scaler, gb->ppu.display, pixels, pitch / sizeof(uint32_t));
+                SDL_UnlockTexture(texture);
             }
-            SDL_UpdateTexture(texture, NULL, pixels, PPU_DISPLAY_WIDTH * sizeof(uint32_t));
             SDL_RenderClear(renderer);
             SDL_RenderCopy(renderer, texture, NULL, NULL);
             SDL_RenderPresent(renderer);
-            ppu.drawFlag = false;
+            gb->ppu.drawFlag = false;
+
+            // battery save
+            mmu_flush(&gb->mmu, false);
         }
+
+        // a frame the debugger stopped part way is finished before pacing it
+        if (debugger.stopped) {
+            continue;
+        }
+
+        deadline += frame_time;
+        uint64_t now = SDL_GetPerformanceCounter();
+        bool behind = now > deadline;
+        if (!behind) {
+            SDL_Delay((deadline - now) * 1000 / frequency);
+        } else if (now - deadline > frame_time * (frameskip + 1)) {
+            // too far behind to catch up, pace from here instead
+            deadline = now;
+        }
+
+        // running behind, the next frame is emulated but not drawn
+        gb->ppu.skip_render = behind && skip_run < frameskip;
+        skip_run = gb->ppu.skip_render ? skip_run + 1 : 0;
+    }
+
+    if (gb->ppu.skipped > 0) {
+        printf("Skipped %u of %u frames\n", gb->ppu.skipped, gb->ppu.frame);
+    }
+
+    movie_close(&movie);
+    if (snapshot != NULL) {
+        snapshot_destroy(snapshot);
+    }
+    gb_destroy(gb);
+    scaler_close(&scaler);
+    if (audio != NULL) {
+        wav_close(audio);
     }
 
     SDL_CloseAudio();
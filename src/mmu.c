@@ -2,14 +2,309 @@
 #include <stdlib.h>
 #include <string.h>
 #include "mmu.h"
+#include "ppu_worker.h"
+#include "debugger.h"
+
+static void mmu_update_colors(uint32_t colors[8][4], const uint8_t* palette, int index);
+static uint8_t mmu_read_joypad(void* context, MMU* mmu, uint16_t address);
+static uint8_t mmu_read_div(void* context, MMU* mmu, uint16_t address);
 
 void mmu_initialize(MMU* mmu) {
-    memset(mmu->data, 0, ROM_SIZE);
+    memset(mmu->io, 0, IO_SIZE);
+
+    // dmg mode needs one vram bank and two wram banks
+    mmu->vram = calloc(1, VRAM_BANK_SIZE);
+    mmu->wram = calloc(2, WRAM_BANK_SIZE);
+    if (mmu->vram == NULL || mmu->wram == NULL) {
+        fprintf(stderr, "Error: Couldn't allocate ram\n");
+        exit(1);
+    }
+    mmu->vram_bank = 0;
+    mmu->wram_bank = 1;
+    mmu->cart = NULL;
+    mmu->boot = NULL;
+    mmu->boot_mapped = false;
+    mmu->buttons = 0;
+    mmu->clock = 0;
+    mmu->div_clock = 0;
+    mmu->dma_end = 0;
+    mmu->worker = NULL;
+    mmu->watch_read = 0;
+    mmu->watch_write = 0;
+    mmu->debugger = NULL;
+
+    mmu->cgb = false;
+    mmu->double_speed = false;
+    mmu->stall = 0;
+    mmu->hdma_source = 0;
+    mmu->hdma_dest = 0;
+    mmu->hdma_blocks = 0;
+    mmu->hdma_active = false;
+
+    // palettes power up white
+    memset(mmu->bg_palette, 0xFF, PALETTE_SIZE);
+    memset(mmu->obj_palette, 0xFF, PALETTE_SIZE);
+    for (int i = 0; i < PALETTE_SIZE; i += 2) {
+        mmu_update_colors(mmu->bg_colors, mmu->bg_palette, i);
+        mmu_update_colors(mmu->obj_colors, mmu->obj_palette, i);
+    }
+
+    memset(mmu->io_read, 0, sizeof(mmu->io_read));
+    memset(mmu->io_context, 0, sizeof(mmu->io_context));
+    mmu_set_read_handler(mmu, 0xFF00, mmu_read_joypad, NULL);
+    mmu_set_read_handler(mmu, 0xFF04, mmu_read_div, NULL);
+
+    mmu_remap(mmu);
 }
 
-void mmu_write(MMU* mmu, uint16_t address, uint8_t value) {
+void mmu_set_read_handler(MMU* mmu, uint16_t address, MMUReadHandler handler, void* context) {
+    mmu->io_read[address - IO_HANDLER_ADDRESS] = handler;
+    mmu->io_context[address - IO_HANDLER_ADDRESS] = context;
+}
+
+void mmu_enable_cgb(MMU* mmu) {
+    // grow to every bank, keeping what is already there
+    uint8_t (*vram)[VRAM_BANK_SIZE] = realloc(mmu->vram, VRAM_BANKS * VRAM_BANK_SIZE);
+    uint8_t (*wram)[WRAM_BANK_SIZE] = realloc(mmu->wram, WRAM_BANKS * WRAM_BANK_SIZE);
+    if (vram == NULL || wram == NULL) {
+        fprintf(stderr, "Error: Couldn't allocate ram\n");
+        exit(1);
+    }
+    memset(vram[1], 0, (VRAM_BANKS - 1) * VRAM_BANK_SIZE);
+    memset(wram[2], 0, (WRAM_BANKS - 2) * WRAM_BANK_SIZE);
+
+    mmu->vram = vram;
+    mmu->wram = wram;
+    mmu->cgb = true;
+    mmu_remap(mmu);
+}
+
+void mmu_close(MMU* mmu) {
+    free(mmu->vram);
+    free(mmu->wram);
+    free(mmu->boot);
+    mmu->vram = NULL;
+    mmu->wram = NULL;
+    mmu->boot = NULL;
+    mmu->boot_mapped = false;
+}
+
+void mmu_remap(MMU* mmu) {
+    // rom reads come straight from the shared mapping, writes go to the mbc
+    for (int page = 0x0; page < 0x8; page++) {
+        mmu->read_page[page] = mmu->cart != NULL ? (uint8_t*)mmu->cart->data + page * MMU_PAGE_SIZE : NULL;
+        mmu->write_page[page] = NULL;
+    }
+
+    // the boot rom covers the start of page 0
+    if (mmu->boot_mapped) {
+        mmu->read_page[0x0] = NULL;
+    }
+
+    // vram, writes take the slow path while a render thread needs to see them
+    mmu->read_page[0x8] = mmu->write_page[0x8] = mmu->vram[mmu->vram_bank];
+    mmu->read_page[0x9] = mmu->write_page[0x9] = mmu->vram[mmu->vram_bank] + MMU_PAGE_SIZE;
+    if (mmu->worker != NULL) {
+        mmu->write_page[0x8] = NULL;
+        mmu->write_page[0x9] = NULL;
+    }
+
+    // cartridge ram, battery saves take one slow write to mark them dirty
+    uint8_t* ram = mmu->cart != NULL ? cart_ram_bank(mmu->cart) : NULL;
+    bool writable = ram != NULL && (mmu->cart->save_fd < 0 || mmu->cart->ram_dirty);
+    mmu->read_page[0xA] = ram;
+    mmu->read_page[0xB] = ram ? ram + MMU_PAGE_SIZE : NULL;
+    mmu->write_page[0xA] = writable ? ram : NULL;
+    mmu->write_page[0xB] = writable ? ram + MMU_PAGE_SIZE : NULL;
+
+    // wram and its echo
+    mmu->read_page[0xC] = mmu->write_page[0xC] = mmu->wram[0];
+    mmu->read_page[0xD] = mmu->write_page[0xD] = mmu->wram[mmu->wram_bank];
+    mmu->read_page[0xE] = mmu->write_page[0xE] = mmu->wram[0];
+
+    // echo, oam, i/o and hram
+    mmu->read_page[0xF] = NULL;
+    mmu->write_page[0xF] = NULL;
+
+    // only hram and i/o are reachable while dma owns the bus
+    if (mmu->clock < mmu->dma_end) {
+        for (int page = 0; page < 0xF; page++) {
+            mmu->read_page[page] = NULL;
+            mmu->write_page[page] = NULL;
+        }
+    }
+
+    // watched pages always take the slow path so the debugger sees them
+    for (int page = 0; page < MMU_PAGES; page++) {
+        mmu->read_map[page] = (mmu->watch_read >> page) & 1 ? NULL : mmu->read_page[page];
+        mmu->write_map[page] = (mmu->watch_write >> page) & 1 ? NULL : mmu->write_page[page];
+    }
+}
+
+static bool mmu_dma_locked(MMU* mmu, uint16_t address) {
+    if (mmu->dma_end == 0) {
+        return false;
+    }
+
+    if (mmu->clock >= mmu->dma_end) {
+        mmu->dma_end = 0;
+        mmu_remap(mmu);
+        return false;
+    }
+
+    return address < 0xFF00;
+}
+
+static void mmu_update_colors(uint32_t colors[8][4], const uint8_t* palette, int index) {
+    // rgb555 to rgba8888
+    index &= 0x3E;
+    uint16_t color = palette[index] | (palette[index + 1] << 8);
+    uint8_t r = color & 0x1F;
+    uint8_t g = (color >> 5) & 0x1F;
+    uint8_t b = (color >> 10) & 0x1F;
+    colors[index / 8][(index / 2) % 4] = ((uint32_t)(r << 3 | r >> 2) << 24) | ((g << 3 | g >> 2) << 16) | ((b << 3 | b >> 2) << 8) | 0xFF;
+}
+
+static void mmu_write_palette(MMU* mmu, uint16_t spec_address, uint8_t* palette, uint32_t colors[8][4], uint8_t value) {
+    uint8_t spec = MMU_IO(mmu, spec_address);
+    int index = spec & 0x3F;
+    palette[index] = value;
+    mmu_update_colors(colors, palette, index);
+
+    if (mmu->worker != NULL && colors == mmu->bg_colors) {
+        ppu_worker_color(mmu->worker, index / 8, (index / 2) % 4, colors[index / 8][(index / 2) % 4]);
+    }
+
+    // auto increment
+    if (spec & 0x80) {
+        MMU_IO(mmu, spec_address) = 0x80 | ((index + 1) & 0x3F);
+    }
+}
+
+static void mmu_hdma_start(MMU* mmu, uint8_t value) {
+    // writing bit 7 clear while an h-blank transfer runs stops it
+    if (mmu->hdma_active && !(value & 0x80)) {
+        mmu->hdma_active = false;
+        return;
+    }
+
+    mmu->hdma_source = ((MMU_IO(mmu, 0xFF51) << 8) | MMU_IO(mmu, 0xFF52)) & 0xFFF0;
+    mmu->hdma_dest = 0x8000 | (((MMU_IO(mmu, 0xFF53) << 8) | MMU_IO(mmu, 0xFF54)) & 0x1FF0);
+    mmu->hdma_blocks = (value & 0x7F) + 1;
+
+    if (value & 0x80) {
+        mmu->hdma_active = true;
+        return;
+    }
+
+    // general purpose - the whole block at once, splitting only where vram wraps
+    while (mmu->hdma_blocks > 0) {
+        int blocks = (0xA000 - mmu->hdma_dest) / 16;
+        if (blocks > mmu->hdma_blocks) {
+            blocks = mmu->hdma_blocks;
+        }
+        mmu_copy(mmu, mmu->hdma_dest, mmu->hdma_source, blocks * 16);
+        mmu->hdma_source += blocks * 16;
+        mmu->hdma_dest = 0x8000 | ((mmu->hdma_dest + blocks * 16) & 0x1FF0);
+        mmu->hdma_blocks -= blocks;
+        mmu->stall += blocks * (mmu->double_speed ? 64 : 32);
+    }
+}
+
+static bool mmu_write_cgb(MMU* mmu, uint16_t address, uint8_t value) {
+    switch (address) {
+        case 0xFF4D: // KEY1
+            MMU_IO(mmu, address) = value & 0x01;
+            return true;
+        case 0xFF4F: // VBK
+            mmu->vram_bank = value & 0x01;
+            mmu_remap(mmu);
+            return true;
+        case 0xFF55: // HDMA5
+            mmu_hdma_start(mmu, value);
+            return true;
+        case 0xFF69: // BCPD
+            mmu_write_palette(mmu, 0xFF68, mmu->bg_palette, mmu->bg_colors, value);
+            return true;
+        case 0xFF6B: // OCPD
+            mmu_write_palette(mmu, 0xFF6A, mmu->obj_palette, mmu->obj_colors, value);
+            return true;
+        case 0xFF70: // SVBK
+            mmu->wram_bank = (value & 0x07) ? (value & 0x07) : 1;
+            MMU_IO(mmu, address) = value & 0x07;
+            mmu_remap(mmu);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool mmu_read_cgb(MMU* mmu, uint16_t address, uint8_t* value) {
+    switch (address) {
+        case 0xFF4D: // KEY1
+            *value = 0x7E | (mmu->double_speed ? 0x80 : 0) | (MMU_IO(mmu, address) & 0x01);
+            return true;
+        case 0xFF4F: // VBK
+            *value = 0xFE | mmu->vram_bank;
+            return true;
+        case 0xFF55: // HDMA5
+            *value = mmu->hdma_active ? (mmu->hdma_blocks - 1) & 0x7F : 0xFF;
+            return true;
+        case 0xFF69: // BCPD
+            *value = mmu->bg_palette[MMU_IO(mmu, 0xFF68) & 0x3F];
+            return true;
+        case 0xFF6B: // OCPD
+            *value = mmu->obj_palette[MMU_IO(mmu, 0xFF6A) & 0x3F];
+            return true;
+        case 0xFF70: // SVBK
+            *value = 0xF8 | MMU_IO(mmu, address);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void mmu_write_slow(MMU* mmu, uint16_t address, uint8_t value) {
+    if (mmu_dma_locked(mmu, address)) {
+        return;
+    }
+
     if (address < 0x8000) {
-        return; // ROM
+        // ROM
+        if (mmu->cart != NULL) {
+            cart_control(mmu->cart, address, value);
+            mmu_remap(mmu);
+        }
+        return;
+    }
+
+    if (address >= 0xA000 && address < 0xC000) {
+        if (mmu->cart != NULL) {
+            bool dirty = mmu->cart->ram_dirty;
+            cart_ram_write(mmu->cart, address, value);
+            if (dirty != mmu->cart->ram_dirty) {
+                mmu_remap(mmu);
+            }
+        }
+        return;
+    }
+
+    if (address < 0xA000 && mmu->worker != NULL) {
+        mmu->vram[mmu->vram_bank][address - 0x8000] = value;
+        ppu_worker_vram(mmu->worker, mmu->vram_bank * VRAM_BANK_SIZE + address - 0x8000, value);
+        return;
+    }
+
+    if (address < 0xF000) {
+        // pages unmapped by a dma that just ended
+        mmu_write(mmu, address, value);
+        return;
+    }
+
+    if (address < OAM_ADDRESS) {
+        // echo ram
+        mmu->wram[mmu->wram_bank][address - 0xF000] = value;
+        return;
     }
 
     if (address >= 0xFF10 && address <= 0xFF26) {
@@ -17,7 +312,61 @@ void mmu_write(MMU* mmu, uint16_t address, uint8_t value) {
         // printf("Writing 0x%02X to sound register 0x%04X\n", value, address);
     }
 
-    mmu->data[address] = value;
+    if (mmu->cgb && mmu_write_cgb(mmu, address, value)) {
+        return;
+    }
+
+    if (address == 0xFF46) {
+        mmu_dma(mmu, value);
+    }
+
+    // any write clears div, ly can't be written
+    if (address == 0xFF04) {
+        mmu->div_clock = mmu->clock;
+        return;
+    }
+    if (address == 0xFF44) {
+        return;
+    }
+
+    // any write to FF50 unmaps the boot rom for good
+    if (address == 0xFF50 && mmu->boot_mapped) {
+        mmu->boot_mapped = false;
+        mmu_remap(mmu);
+    }
+
+    MMU_IO(mmu, address) = value;
+}
+
+static void mmu_write_watched(MMU* mmu, uint16_t address, uint8_t value) {
+    debugger_access(mmu->debugger, address, value, DEBUG_WRITE);
+
+    if (mmu_dma_locked(mmu, address)) {
+        return;
+    }
+
+    uint8_t* page = mmu->write_page[address >> MMU_PAGE_SHIFT];
+    if (page != NULL) {
+        page[address & (MMU_PAGE_SIZE - 1)] = value;
+        return;
+    }
+
+    mmu_write_slow(mmu, address, value);
+}
+
+void mmu_write(MMU* mmu, uint16_t address, uint8_t value) {
+    uint8_t* page = mmu->write_map[address >> MMU_PAGE_SHIFT];
+    if (page != NULL) {
+        page[address & (MMU_PAGE_SIZE - 1)] = value;
+        return;
+    }
+
+    if ((mmu->watch_write >> (address >> MMU_PAGE_SHIFT)) & 1) {
+        mmu_write_watched(mmu, address, value);
+        return;
+    }
+
+    mmu_write_slow(mmu, address, value);
 }
 
 void mmu_write16(MMU* mmu, uint16_t address, uint16_t value) {
@@ -25,25 +374,299 @@ void mmu_write16(MMU* mmu, uint16_t address, uint16_t value) {
     mmu_write(mmu, address + 1, value >> 8);
 }
 
+static uint8_t mmu_read_joypad(void* context, MMU* mmu, uint16_t address) {
+    uint8_t select = MMU_IO(mmu, 0xFF00) & 0x30;
+    uint8_t pressed = 0;
+
+    // a cleared select bit picks its row, pressed buttons read 0
+    if (!(select & 0x10)) {
+        pressed |= mmu->buttons & 0x0F;
+    }
+    if (!(select & 0x20)) {
+        pressed |= mmu->buttons >> 4;
+    }
+
+    return 0xC0 | select | (~pressed & 0x0F);
+}
+
+static uint8_t mmu_read_div(void* context, MMU* mmu, uint16_t address) {
+    // 16384Hz, or twice that in double speed, which the cpu clock already is
+    return (mmu->clock - mmu->div_clock) >> 8;
+}
+
+uint8_t mmu_read_memory(MMU* mmu, uint16_t address) {
+    // straight from the banks, whether or not the map has them unmapped
+    if (address < 0x8000) {
+        if (address < BOOT_SIZE && mmu->boot_mapped) {
+            return mmu->boot[address];
+        }
+        return mmu->cart != NULL ? mmu->cart->data[address] : 0xFF;
+    }
+
+    if (address < 0xA000) {
+        return mmu->vram[mmu->vram_bank][address - 0x8000];
+    }
+
+    if (address < 0xC000) {
+        return mmu->cart != NULL ? cart_ram_read(mmu->cart, address) : 0xFF;
+    }
+
+    if (address < 0xD000) {
+        return mmu->wram[0][address - 0xC000];
+    }
+
+    if (address < 0xE000) {
+        return mmu->wram[mmu->wram_bank][address - 0xD000];
+    }
+
+    if (address < 0xF000) {
+        return mmu->wram[0][address - 0xE000];
+    }
+
+    if (address < OAM_ADDRESS) {
+        // echo ram
+        return mmu->wram[mmu->wram_bank][address - 0xF000];
+    }
+
+    // time derived registers are worked out now rather than kept up to date
+    int index = address - IO_HANDLER_ADDRESS;
+    if (index >= 0 && index < IO_HANDLERS && mmu->io_read[index] != NULL) {
+        return mmu->io_read[index](mmu->io_context[index], mmu, address);
+    }
+
+    uint8_t value;
+    if (mmu->cgb && mmu_read_cgb(mmu, address, &value)) {
+        return value;
+    }
+
+    return MMU_IO(mmu, address);
+}
+
+static uint8_t mmu_read_slow(MMU* mmu, uint16_t address) {
+    if (mmu_dma_locked(mmu, address)) {
+        return 0xFF;
+    }
+
+    return mmu_read_memory(mmu, address);
+}
+
+static uint8_t mmu_read_watched(MMU* mmu, uint16_t address) {
+    uint8_t value = 0xFF;
+    if (!mmu_dma_locked(mmu, address)) {
+        uint8_t* page = mmu->read_page[address >> MMU_PAGE_SHIFT];
+        value = page != NULL ? page[address & (MMU_PAGE_SIZE - 1)] : mmu_read_slow(mmu, address);
+    }
+
+    debugger_access(mmu->debugger, address, value, DEBUG_READ);
+    return value;
+}
+
 uint8_t mmu_read(MMU* mmu, uint16_t address) {
-    return mmu->data[address];
+    uint8_t* page = mmu->read_map[address >> MMU_PAGE_SHIFT];
+    if (page != NULL) {
+        return page[address & (MMU_PAGE_SIZE - 1)];
+    }
+
+    if ((mmu->watch_read >> (address >> MMU_PAGE_SHIFT)) & 1) {
+        return mmu_read_watched(mmu, address);
+    }
+
+    return mmu_read_slow(mmu, address);
+}
+
+uint8_t mmu_peek(MMU* mmu, uint16_t address) {
+    // reads through the map as it is before watched pages are taken out,
+    // so the debugger can look at memory without tripping its own points
+    if (mmu_dma_locked(mmu, address)) {
+        return 0xFF;
+    }
+
+    uint8_t* page = mmu->read_page[address >> MMU_PAGE_SHIFT];
+    if (page != NULL) {
+        return page[address & (MMU_PAGE_SIZE - 1)];
+    }
+
+    return mmu_read_slow(mmu, address);
 }
 
 uint16_t mmu_read16(MMU* mmu, uint16_t address) {
     return mmu_read(mmu, address) | (mmu_read(mmu, address + 1) << 8);
 }
 
-void mmu_load_bios(MMU* mmu, const char* path) {
+void mmu_copy(MMU* mmu, uint16_t dest, uint16_t source, int length) {
+    // one memcpy per run of mapped pages, byte by byte through the slow path otherwise
+    while (length > 0) {
+        int chunk = MMU_PAGE_SIZE - (source & (MMU_PAGE_SIZE - 1));
+        if (chunk > MMU_PAGE_SIZE - (dest & (MMU_PAGE_SIZE - 1))) {
+            chunk = MMU_PAGE_SIZE - (dest & (MMU_PAGE_SIZE - 1));
+        }
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        uint8_t* from = mmu->read_map[source >> MMU_PAGE_SHIFT];
+        uint8_t* to = mmu->write_map[dest >> MMU_PAGE_SHIFT];
+        if (from != NULL && to != NULL) {
+            memcpy(to + (dest & (MMU_PAGE_SIZE - 1)), from + (source & (MMU_PAGE_SIZE - 1)), chunk);
+        } else {
+            for (int i = 0; i < chunk; i++) {
+                mmu_write(mmu, dest + i, mmu_read(mmu, source + i));
+            }
+        }
+
+        dest += chunk;
+        source += chunk;
+        length -= chunk;
+    }
+}
+
+void mmu_dma(MMU* mmu, uint8_t page) {
+    // sources above 0xDF read the echo of wram
+    if (page >= 0xE0) {
+        page -= 0x20;
+    }
+
+    // the whole transfer lands at once through the memory map
+    uint16_t source = page << 8;
+    uint8_t* source_page = mmu->read_map[source >> MMU_PAGE_SHIFT];
+    if (source_page != NULL) {
+        memcpy(&MMU_IO(mmu, OAM_ADDRESS), source_page + (source & (MMU_PAGE_SIZE - 1)), OAM_SIZE);
+    } else {
+        for (int i = 0; i < OAM_SIZE; i++) {
+            MMU_IO(mmu, OAM_ADDRESS + i) = mmu_read(mmu, source + i);
+        }
+    }
+
+    // the bus stays locked for the transfer's duration
+    mmu->dma_end = mmu->clock + DMA_CYCLES;
+    mmu_remap(mmu);
+}
+
+void mmu_hdma_hblank(MMU* mmu) {
+    if (!mmu->hdma_active) {
+        return;
+    }
+
+    // one 16 byte block per h-blank
+    mmu_copy(mmu, mmu->hdma_dest, mmu->hdma_source, 16);
+    mmu->hdma_source += 16;
+    mmu->hdma_dest = 0x8000 | ((mmu->hdma_dest + 16) & 0x1FF0);
+    mmu->stall += mmu->double_speed ? 64 : 32;
+
+    if (--mmu->hdma_blocks == 0) {
+        mmu->hdma_active = false;
+    }
+}
+
+bool mmu_speed_switch(MMU* mmu) {
+    // stop switches speed when KEY1 was armed
+    if (!mmu->cgb || !(MMU_IO(mmu, 0xFF4D) & 0x01)) {
+        return false;
+    }
+
+    mmu->double_speed = !mmu->double_speed;
+    MMU_IO(mmu, 0xFF4D) = 0;
+    return true;
+}
+
+void mmu_cycle(MMU* mmu, int cycles) {
+    mmu->clock += cycles;
+}
+
+void mmu_flush(MMU* mmu, bool force) {
+    // clean saves unmap their pages again so the next write marks them dirty
+    if (mmu->cart != NULL && cart_flush(mmu->cart, force)) {
+        mmu_remap(mmu);
+    }
+}
+
+void mmu_set_buttons(MMU* mmu, uint8_t buttons) {
+    // new presses raise the joypad interrupt
+    if (buttons & ~mmu->buttons) {
+        MMU_IO(mmu, 0xFF0F) |= 0x10;
+    }
+
+    mmu->buttons = buttons;
+}
+
+bool mmu_load_bios(MMU* mmu, const char* path) {
     FILE* file = fopen(path, "rb");
     if (file == NULL) {
         fprintf(stderr, "Error: Could not open BIOS %s\n", path);
-        exit(1);
+        return false;
+    }
+
+    mmu->boot = calloc(1, BOOT_SIZE);
+    if (mmu->boot == NULL) {
+        fclose(file);
+        return false;
     }
 
-    fread(mmu->data, 1, 0x100, file);
+    fread(mmu->boot, 1, BOOT_SIZE, file);
     fclose(file);
+    mmu->boot_mapped = true;
+    mmu_remap(mmu);
+
+    return true;
+}
+
+void mmu_fast_boot(MMU* mmu) {
+    // i/o registers as the dmg boot rom leaves them
+    static const struct { uint16_t address; uint8_t value; } io[] = {
+        { 0xFF00, 0xCF }, { 0xFF04, 0xAB }, { 0xFF05, 0x00 }, { 0xFF06, 0x00 },
+        { 0xFF07, 0xF8 }, { 0xFF0F, 0xE1 }, { 0xFF10, 0x80 }, { 0xFF11, 0xBF },
+        { 0xFF12, 0xF3 }, { 0xFF14, 0xBF }, { 0xFF16, 0x3F }, { 0xFF17, 0x00 },
+        { 0xFF19, 0xBF }, { 0xFF1A, 0x7F }, { 0xFF1B, 0xFF }, { 0xFF1C, 0x9F },
+        { 0xFF1E, 0xBF }, { 0xFF20, 0xFF }, { 0xFF21, 0x00 }, { 0xFF22, 0x00 },
+        { 0xFF23, 0xBF }, { 0xFF24, 0x77 }, { 0xFF25, 0xF3 }, { 0xFF26, 0xF1 },
+        { 0xFF40, 0x91 }, { 0xFF41, 0x85 }, { 0xFF42, 0x00 }, { 0xFF43, 0x00 },
+        { 0xFF45, 0x00 }, { 0xFF47, 0xFC }, { 0xFF48, 0xFF }, { 0xFF49, 0xFF },
+        { 0xFF4A, 0x00 }, { 0xFF4B, 0x00 }, { 0xFF50, 0x01 }, { 0xFFFF, 0x00 },
+    };
+
+    for (int i = 0; i < sizeof(io) / sizeof(io[0]); i++) {
+        MMU_IO(mmu, io[i].address) = io[i].value;
+    }
+    mmu->div_clock = mmu->clock - (MMU_IO(mmu, 0xFF04) << 8);
+
+    // logo tiles - every bit of the cart logo doubled, every row drawn twice
+    uint8_t* vram = mmu->vram[0];
+    uint16_t tile = 0x0010;
+    for (int i = 0; i < 48; i++) {
+        uint8_t logo = mmu_read(mmu, 0x0104 + i);
+        for (int nibble = 0; nibble < 2; nibble++) {
+            uint8_t bits = nibble ? logo & 0x0F : logo >> 4;
+            uint8_t row = 0;
+            for (int bit = 3; bit >= 0; bit--) {
+                row = (row << 2) | (((bits >> bit) & 1) * 0x03);
+            }
+            vram[tile] = row;
+            vram[tile + 2] = row;
+            tile += 4;
+        }
+    }
+
+    // registered mark tile
+    static const uint8_t registered[] = { 0x3C, 0x42, 0xB9, 0xA5, 0xB9, 0xA5, 0x42, 0x3C };
+    for (int i = 0; i < 8; i++) {
+        vram[tile + i * 2] = registered[i];
+    }
+
+    // logo map - two rows of 12 tiles plus the mark
+    for (int i = 0; i < 12; i++) {
+        vram[0x1904 + i] = 0x01 + i;
+        vram[0x1924 + i] = 0x0D + i;
+    }
+    vram[0x1910] = 0x19;
+
+    // cgb banking registers
+    if (mmu->cgb) {
+        MMU_IO(mmu, 0xFF4D) = 0x00;
+        MMU_IO(mmu, 0xFF70) = 0x01;
+    }
 }
 
 void mmu_load_cart(MMU* mmu, Cart* cart) {
-    memcpy(mmu->data, cart->data, cart->size);
+    mmu->cart = cart;
+    mmu_remap(mmu);
 }
@@ -5,18 +5,130 @@
 #include <stdbool.h>
 #include "cart.h"
 
-#define ROM_SIZE 0xFFFF
+#define ROM_SIZE 0x8000
+#define BOOT_SIZE 0x100
+
+// oam, i/o and hram are the only part of the map the mmu backs itself
+#define IO_ADDRESS 0xFE00
+#define IO_SIZE 0x200
+#define MMU_IO(mmu, address) ((mmu)->io[(address) - IO_ADDRESS])
+
+// registers in FF00-FF7F can be worked out when read instead of stored
+#define IO_HANDLER_ADDRESS 0xFF00
+#define IO_HANDLERS 0x80
+
+#define MMU_PAGE_SHIFT 12
+#define MMU_PAGE_SIZE (1 << MMU_PAGE_SHIFT)
+#define MMU_PAGES 16
+
+#define VRAM_BANK_SIZE 0x2000
+#define VRAM_BANKS 2
+#define WRAM_BANK_SIZE 0x1000
+#define WRAM_BANKS 8
+
+#define OAM_ADDRESS 0xFE00
+#define OAM_SIZE 0xA0
+#define DMA_CYCLES (OAM_SIZE * 4) // 160 m-cycles
+
+#define PALETTE_SIZE 64 // 8 palettes of 4 rgb555 colors
+
+// joypad buttons, set bits are pressed
+#define JOYPAD_RIGHT 0x01
+#define JOYPAD_LEFT 0x02
+#define JOYPAD_UP 0x04
+#define JOYPAD_DOWN 0x08
+#define JOYPAD_A 0x10
+#define JOYPAD_B 0x20
+#define JOYPAD_SELECT 0x40
+#define JOYPAD_START 0x80
+
+struct ppu_worker;
+struct debugger;
+struct mmu;
+
+typedef uint8_t (*MMUReadHandler)(void* context, struct mmu* mmu, uint16_t address);
 
 typedef struct mmu {
-    uint8_t data[ROM_SIZE];
+    uint8_t io[IO_SIZE];
+
+    // read handlers for time derived registers, NULL reads io
+    MMUReadHandler io_read[IO_HANDLERS];
+    void* io_context[IO_HANDLERS];
+
+    // banked ram on the heap, dmg mode only allocates the first banks
+    uint8_t (*vram)[VRAM_BANK_SIZE];
+    uint8_t (*wram)[WRAM_BANK_SIZE];
+    int vram_bank;
+    int wram_bank;
+
+    // memory map - 4KB pages, NULL pages go through the slow path
+    uint8_t* read_map[MMU_PAGES];
+    uint8_t* write_map[MMU_PAGES];
+
+    // the map before watched pages are taken out of it, one bit per page
+    uint8_t* read_page[MMU_PAGES];
+    uint8_t* write_page[MMU_PAGES];
+    uint16_t watch_read;
+    uint16_t watch_write;
+    struct debugger* debugger;
+
+    // cartridge, and the boot rom over it until FF50 is written - the
+    // buffer itself is kept until close so a snapshot can map it back
+    Cart* cart;
+    uint8_t* boot;
+    bool boot_mapped;
+
+    // joypad
+    uint8_t buttons;
+
+    // clock, div counts up from div_clock
+    uint64_t clock;
+    uint64_t div_clock;
+
+    // oam dma - bus locked until dma_end
+    uint64_t dma_end;
+
+    // cgb
+    bool cgb;
+    bool double_speed;
+    int stall; // cycles the cpu loses to general purpose hdma
+
+    // cgb palettes, also kept as rgba for the ppu
+    uint8_t bg_palette[PALETTE_SIZE];
+    uint8_t obj_palette[PALETTE_SIZE];
+    uint32_t bg_colors[8][4];
+    uint32_t obj_colors[8][4];
+
+    // render thread fed with vram and palette writes
+    struct ppu_worker* worker;
+
+    // cgb hdma
+    uint16_t hdma_source;
+    uint16_t hdma_dest;
+    int hdma_blocks;
+    bool hdma_active;
 } MMU;
 
 void mmu_initialize(MMU* mmu);
+void mmu_enable_cgb(MMU* mmu);
+void mmu_close(MMU* mmu);
+void mmu_remap(MMU* mmu);
+void mmu_set_read_handler(MMU* mmu, uint16_t address, MMUReadHandler handler, void* context);
 void mmu_write(MMU* mmu, uint16_t address, uint8_t value);
 void mmu_write16(MMU* mmu, uint16_t address, uint16_t value);
 uint8_t mmu_read(MMU* mmu, uint16_t address);
 uint16_t mmu_read16(MMU* mmu, uint16_t address);
-void mmu_load_bios(MMU* mmu, const char* filename);
+uint8_t mmu_peek(MMU* mmu, uint16_t address);
+uint8_t mmu_read_memory(MMU* mmu, uint16_t address);
+void mmu_copy(MMU* mmu, uint16_t dest, uint16_t source, int length);
+void mmu_dma(MMU* mmu, uint8_t page);
+void mmu_hdma_hblank(MMU* mmu);
+bool mmu_speed_switch(MMU* mmu);
+void mmu_cycle(MMU* mmu, int cycles);
+void mmu_flush(MMU* mmu, bool force);
+void mmu_set_buttons(MMU* mmu, uint8_t buttons);
+bool mmu_load_bios(MMU* mmu, const char* filename);
+void mmu_fast_boot(MMU* mmu);
 void mmu_load_cart(MMU* mmu, Cart* cart);
 
 #endif
@@ -0,0 +1,141 @@
+#include <string.h>
+#include "movie.h"
+
+// file layout
+//   "GBMV" version flags checksum(2)
+//   events: varint (frame delta << 1 | end) [buttons]
+
+static uint16_t movie_checksum(Cart* cart) {
+    return (cart->data[0x14E] << 8) | cart->data[0x14F];
+}
+
+static void movie_write_varint(FILE* file, uint32_t value) {
+    while (value >= 0x80) {
+        fputc((value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+static bool movie_read_varint(FILE* file, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void movie_next(Movie* movie) {
+    uint32_t event;
+    int buttons;
+
+    if (!movie_read_varint(movie->file, &event) || (event & 1)) {
+        movie->next_frame = movie->frame + (event >> 1);
+        movie->done = true;
+        return;
+    }
+
+    buttons = fgetc(movie->file);
+    if (buttons == EOF) {
+        movie->done = true;
+        return;
+    }
+
+    movie->next_frame = movie->frame + (event >> 1);
+    movie->next_buttons = buttons;
+}
+
+void movie_initialize(Movie* movie) {
+    memset(movie, 0, sizeof(Movie));
+}
+
+bool movie_record(Movie* movie, const char* path, Cart* cart, uint8_t flags) {
+    movie->file = fopen(path, "wb");
+    if (movie->file == NULL) {
+        fprintf(stderr, "Error: Couldn't create movie %s\n", path);
+        return false;
+    }
+
+    uint16_t checksum = movie_checksum(cart);
+    fwrite(MOVIE_MAGIC, 1, 4, movie->file);
+    fputc(MOVIE_VERSION, movie->file);
+    fputc(flags, movie->file);
+    fputc(checksum >> 8, movie->file);
+    fputc(checksum & 0xFF, movie->file);
+
+    movie->recording = true;
+    movie->flags = flags;
+    return true;
+}
+
+bool movie_play(Movie* movie, const char* path, Cart* cart) {
+    movie->file = fopen(path, "rb");
+    if (movie->file == NULL) {
+        fprintf(stderr, "Error: Couldn't open movie %s\n", path);
+        return false;
+    }
+
+    uint8_t header[8];
+    if (fread(header, 1, 8, movie->file) != 8 || memcmp(header, MOVIE_MAGIC, 4) != 0 || header[4] != MOVIE_VERSION) {
+        fprintf(stderr, "Error: Not a movie %s\n", path);
+        movie_close(movie);
+        return false;
+    }
+
+    if (((header[6] << 8) | header[7]) != movie_checksum(cart)) {
+        fprintf(stderr, "Error: Movie %s was recorded with a different rom\n", path);
+        movie_close(movie);
+        return false;
+    }
+
+    movie->playing = true;
+    movie->flags = header[5];
+    movie_next(movie);
+    return true;
+}
+
+uint8_t movie_frame(Movie* movie, uint32_t frame, uint8_t buttons) {
+    if (movie->recording) {
+        if (buttons != movie->buttons) {
+            movie_write_varint(movie->file, (frame - movie->frame) << 1);
+            fputc(buttons, movie->file);
+            movie->frame = frame;
+            movie->buttons = buttons;
+        }
+        movie->length = frame + 1;
+    } else if (movie->playing) {
+        while (!movie->done && frame >= movie->next_frame) {
+            movie->frame = movie->next_frame;
+            movie->buttons = movie->next_buttons;
+            movie_next(movie);
+        }
+        if (movie->done && frame >= movie->next_frame) {
+            movie->playing = false;
+        }
+    } else {
+        return buttons;
+    }
+
+    return movie->buttons;
+}
+
+void movie_close(Movie* movie) {
+    if (movie->file == NULL) {
+        return;
+    }
+
+    // the end marker keeps trailing frames without input changes
+    if (movie->recording) {
+        movie_write_varint(movie->file, ((movie->length - movie->frame) << 1) | 1);
+    }
+
+    fclose(movie->file);
+    movie->file = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cart.h"
+
+#define MOVIE_MAGIC "GBMV"
+#define MOVIE_VERSION 1
+
+// flags
+#define MOVIE_FAST_BOOT 0x01
+#define MOVIE_ACCURATE 0x02
+
+typedef struct movie {
+    FILE* file;
+    bool recording;
+    bool playing;
+    uint8_t flags;
+
+    // joypad state, changes are stored as (frame delta, buttons)
+    uint8_t buttons;
+    uint32_t frame;
+    uint32_t length;
+
+    // playback
+    uint32_t next_frame;
+    uint8_t next_buttons;
+    bool done;
+} Movie;
+
+void movie_initialize(Movie* movie);
+bool movie_record(Movie* movie, const char* path, Cart* cart, uint8_t flags);
+bool movie_play(Movie* movie, const char* path, Cart* cart);
+uint8_t movie_frame(Movie* movie, uint32_t frame, uint8_t buttons);
+void movie_close(Movie* movie);
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "pool.h"
+
+struct pool {
+    pthread_t threads[POOL_MAX_THREADS];
+    int count; // threads including the caller
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned generation;
+    int pending;
+    bool quit;
+
+    // current job
+    PoolTask task;
+    void* arg;
+    int size;
+};
+
+typedef struct {
+    Pool* pool;
+    int index;
+} PoolWorker;
+
+static void pool_slice(Pool* pool, int index) {
+    int start = pool->size * index / pool->count;
+    int end = pool->size * (index + 1) / pool->count;
+    if (start < end) {
+        pool->task(pool->arg, start, end);
+    }
+}
+
+static void* pool_worker(void* arg) {
+    PoolWorker* worker = arg;
+    Pool* pool = worker->pool;
+    int index = worker->index;
+    free(worker);
+
+    unsigned generation = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->generation == generation) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_slice(pool, index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+Pool* pool_create(int threads) {
+    Pool* pool = calloc(1, sizeof(Pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > POOL_MAX_THREADS) {
+        threads = POOL_MAX_THREADS;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // the caller runs slice 0 itself
+    pool->count = 1;
+    for (int i = 1; i < threads; i++) {
+        PoolWorker* worker = malloc(sizeof(PoolWorker));
+        if (worker == NULL) {
+            break;
+        }
+        worker->pool = pool;
+        worker->index = i;
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, worker) != 0) {
+            free(worker);
+            break;
+        }
+        pool->count++;
+    }
+
+    return pool;
+}
+
+int pool_threads(Pool* pool) {
+    return pool->count;
+}
+
+void pool_run(Pool* pool, PoolTask task, void* arg, int count) {
+    if (pool->count == 1) {
+        task(arg, 0, count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->size = count;
+    pool->pending = pool->count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_slice(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(Pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
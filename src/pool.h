@@ -0,0 +1,18 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+
+#define POOL_MAX_THREADS 32
+
+// runs task over [start, end) slices of a range, one slice per thread
+typedef void (*PoolTask)(void* arg, int start, int end);
+
+typedef struct pool Pool;
+
+Pool* pool_create(int threads);
+int pool_threads(Pool* pool);
+void pool_run(Pool* pool, PoolTask task, void* arg, int count);
+void pool_destroy(Pool* pool);
+
+#endif
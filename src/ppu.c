@@ -2,70 +2,170 @@
 #include <string.h>
 #include "ppu.h"
 #include "mmu.h"
+#include "ppu_worker.h"
+
+#define LINE_CYCLES 456
+#define OAM_CYCLES 80     // end of oam search
+#define HBLANK_CYCLE 252 // end of oam search and pixel transfer
+
+// map to grayscale
+static const uint32_t grayscale[4] = {
+    0xFFFFFFFF, // white
+    0xAAAAAAFF, // light gray
+    0x555555FF, // dark gray
+    0x000000FF, // black
+};
+
+static uint8_t ppu_read_ly(void* context, MMU* mmu, uint16_t address) {
+    PPU* ppu = context;
+    return ppu->scanline;
+}
+
+static uint8_t ppu_read_stat(void* context, MMU* mmu, uint16_t address) {
+    PPU* ppu = context;
+
+    // mode from how far into the line the ppu is
+    uint8_t mode;
+    if (ppu->scanline >= 144) {
+        mode = 1;
+    } else if (ppu->cycle_count < OAM_CYCLES) {
+        mode = 2;
+    } else if (ppu->cycle_count < HBLANK_CYCLE) {
+        mode = 3;
+    } else {
+        mode = 0;
+    }
+
+    // interrupt selects are the only bits the cpu writes
+    uint8_t coincidence = ppu->scanline == MMU_IO(mmu, 0xFF45) ? 0x04 : 0;
+    return 0x80 | (MMU_IO(mmu, 0xFF41) & 0x78) | coincidence | mode;
+}
 
 void ppu_initialize(PPU* ppu, MMU* mmu) {
     memset(ppu->display, 0, sizeof(ppu->display));
     ppu->cycle_count = 0;
     ppu->scanline = 0;
     ppu->drawFlag = false;
+    ppu->frame = 0;
+    ppu->skip_render = false;
+    ppu->skipped = 0;
+    ppu->worker = NULL;
+
+    // ly and stat come from where the ppu is when they are read
+    mmu_set_read_handler(mmu, 0xFF44, ppu_read_ly, ppu);
+    mmu_set_read_handler(mmu, 0xFF41, ppu_read_stat, ppu);
 
     // set lcdc to enable lcd display
     mmu_write(mmu, 0xFF40, 0x91); // enable lcd and bg display
-    mmu_write(mmu, 0xFF44, 0);    // initialize ly to 0
 }
 
-void render_scanline(PPU* ppu, MMU* mmu) {
-    uint16_t map_offset = 0x9800;
-    uint8_t scroll_y = mmu_read(mmu, 0xFF42);
-    uint8_t scroll_x = mmu_read(mmu, 0xFF43);
+bool ppu_start_worker(PPU* ppu, MMU* mmu) {
+    ppu->worker = ppu_worker_create(mmu, ppu->display);
+    if (ppu->worker == NULL) {
+        return false;
+    }
+
+    // vram and palette writes now also go to the worker
+    mmu->worker = ppu->worker;
+    mmu_remap(mmu);
+    return true;
+}
+
+void ppu_stop_worker(PPU* ppu, MMU* mmu) {
+    if (ppu->worker == NULL) {
+        return;
+    }
+
+    ppu_worker_destroy(ppu->worker);
+    ppu->worker = NULL;
+    mmu->worker = NULL;
+    mmu_remap(mmu);
+}
 
-    for (int x = 0; x < PPU_DISPLAY_WIDTH; x++) {
-        uint8_t pixel_y = (ppu->scanline + scroll_y) % 256;
-        uint8_t pixel_x = (x + scroll_x) % 256;
-        uint16_t tile_index = (pixel_y / 8) * 32 + (pixel_x / 8);
-        uint8_t tile_id = mmu_read(mmu, map_offset + tile_index);
+void ppu_render_line(const PPULine* line, const uint8_t vram[VRAM_BANKS][VRAM_BANK_SIZE], const uint32_t bg_colors[8][4], uint32_t* pixels) {
+    uint16_t map_offset = 0x9800 - 0x8000;
+
+    uint8_t pixel_y = (line->scanline + line->scroll_y) % 256;
+    const uint8_t* map = vram[0] + map_offset + (pixel_y / 8) * 32;
+    const uint8_t* attributes = line->cgb ? vram[1] + map_offset + (pixel_y / 8) * 32 : NULL; // dmg has no bank 1
+
+    // one tile row fetch per 8 pixels
+    int x = 0;
+    while (x < PPU_DISPLAY_WIDTH) {
+        uint8_t pixel_x = (x + line->scroll_x) % 256;
+        uint8_t tile_id = map[pixel_x / 8];
+
+        // cgb attributes - palette, vram bank, x and y flip
+        uint8_t attribute = line->cgb ? attributes[pixel_x / 8] : 0;
+        const uint32_t* colors = line->cgb ? bg_colors[attribute & 0x07] : grayscale;
 
-        uint16_t tile_address = 0x8000 + tile_id * 16;
         uint8_t tile_row = pixel_y % 8;
-        uint8_t tile_data1 = mmu_read(mmu, tile_address + tile_row * 2);
-        uint8_t tile_data2 = mmu_read(mmu, tile_address + tile_row * 2 + 1);
-        uint8_t color_bit = 7 - (pixel_x % 8);
-        uint8_t color = ((tile_data2 >> color_bit) & 1) << 1 | ((tile_data1 >> color_bit) & 1);
-
-        // map to grayscale
-        uint32_t color_value = 0xFFFFFFFF;
-        if (color == 0) color_value = 0xFFFFFFFF;      // white
-        else if (color == 1) color_value = 0xAAAAAAFF; // light gray
-        else if (color == 2) color_value = 0x555555FF; // dark gray
-        else if (color == 3) color_value = 0x000000FF; // black
-
-        ppu->display[ppu->scanline * PPU_DISPLAY_WIDTH + x] = color_value;
+        if (attribute & 0x40) {
+            tile_row = 7 - tile_row;
+        }
+
+        const uint8_t* tile = vram[(attribute >> 3) & 1] + tile_id * 16 + tile_row * 2;
+        uint8_t tile_data1 = tile[0];
+        uint8_t tile_data2 = tile[1];
+
+        for (int bit = pixel_x % 8; bit < 8 && x < PPU_DISPLAY_WIDTH; bit++, x++) {
+            uint8_t color_bit = (attribute & 0x20) ? bit : 7 - bit;
+            uint8_t color = ((tile_data2 >> color_bit) & 1) << 1 | ((tile_data1 >> color_bit) & 1);
+            pixels[x] = colors[color];
+        }
+    }
+}
+
+static void render_scanline(PPU* ppu, MMU* mmu) {
+    PPULine line;
+    line.scanline = ppu->scanline;
+    line.scroll_y = MMU_IO(mmu, 0xFF42);
+    line.scroll_x = MMU_IO(mmu, 0xFF43);
+    line.cgb = mmu->cgb;
+
+    // the worker draws from its own copy of vram, kept in step by the mmu
+    if (ppu->worker != NULL) {
+        ppu_worker_line(ppu->worker, &line);
+        return;
     }
+
+    ppu_render_line(&line, mmu->vram, mmu->bg_colors, ppu->display + ppu->scanline * PPU_DISPLAY_WIDTH);
 }
 
-void ppu_cycle(PPU* ppu, MMU* mmu) {
-    ppu->cycle_count++;
+void ppu_cycle(PPU* ppu, MMU* mmu, int cycles) {
+    int previous = ppu->cycle_count;
+    ppu->cycle_count += cycles;
 
-    if (ppu->cycle_count >= 456) {
-        ppu->cycle_count = 0;
+    // h-blank hdma moves one block per visible line
+    if (mmu->hdma_active && ppu->scanline < 144 && previous < HBLANK_CYCLE && ppu->cycle_count >= HBLANK_CYCLE) {
+        mmu_hdma_hblank(mmu);
+    }
+
+    while (ppu->cycle_count >= LINE_CYCLES) {
+        ppu->cycle_count -= LINE_CYCLES;
         ppu->scanline++;
 
         if (ppu->scanline < 144) {
             // visible scanlines
-            mmu_write(mmu, 0xFF44, ppu->scanline);
-            render_scanline(ppu, mmu);
+            if (!ppu->skip_render) {
+                render_scanline(ppu, mmu);
+            }
         } else if (ppu->scanline == 144) {
-            // start of v-blank
-            ppu->drawFlag = true;
-            mmu_write(mmu, 0xFF44, 144);
+            // start of v-blank, the frame is complete once the worker catches up
+            if (ppu->worker != NULL) {
+                ppu_worker_sync(ppu->worker);
+            }
+            ppu->drawFlag = !ppu->skip_render;
+            ppu->skipped += ppu->skip_render;
+            ppu->frame++;
         } else if (ppu->scanline > 153) {
             // end of v-blank
             ppu->scanline = 0;
-            mmu_write(mmu, 0xFF44, ppu->scanline);
             ppu->drawFlag = false;
-        } else {
-            // v-blank period
-            mmu_write(mmu, 0xFF44, ppu->scanline);
+        }
+
+        if (mmu->hdma_active && ppu->scanline < 144 && ppu->cycle_count >= HBLANK_CYCLE) {
+            mmu_hdma_hblank(mmu);
         }
     }
 }
@@ -8,6 +8,15 @@
 #define PPU_DISPLAY_WIDTH 160
 #define PPU_DISPLAY_HEIGHT 144
 #define PPU_DISPLAY_SIZE (PPU_DISPLAY_WIDTH * PPU_DISPLAY_HEIGHT)
+#define PPU_FRAME_CYCLES 70224 // 154 lines of 456 cycles
+
+// registers a scanline is drawn with
+typedef struct {
+    uint8_t scanline;
+    uint8_t scroll_x;
+    uint8_t scroll_y;
+    bool cgb;
+} PPULine;
 
 typedef struct {
     uint32_t display[PPU_DISPLAY_SIZE];
@@ -15,9 +24,20 @@ typedef struct {
     int scanline;
     bool drawFlag;
     int mode;
+    uint32_t frame;
+
+    // frame skipping - timing runs as usual, the lines just aren't drawn
+    bool skip_render;
+    uint32_t skipped;
+
+    // render thread, NULL renders inline
+    struct ppu_worker* worker;
 } PPU;
 
 void ppu_initialize(PPU* ppu, MMU* mmu);
-void ppu_cycle(PPU* ppu, MMU* mmu);
+bool ppu_start_worker(PPU* ppu, MMU* mmu);
+void ppu_stop_worker(PPU* ppu, MMU* mmu);
+void ppu_render_line(const PPULine* line, const uint8_t vram[VRAM_BANKS][VRAM_BANK_SIZE], const uint32_t bg_colors[8][4], uint32_t* pixels);
+void ppu_cycle(PPU* ppu, MMU* mmu, int cycles);
 
 #endif
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "ppu_worker.h"
+
+// the emulation thread streams vram writes, palette changes and line
+// snapshots in order, the worker replays them into its own copy of vram
+// and rasterizes each line exactly as it would have been drawn inline
+
+enum {
+    COMMAND_VRAM,
+    COMMAND_COLOR,
+    COMMAND_LINE,
+};
+
+typedef struct {
+    uint8_t type;
+    uint8_t index;
+    uint16_t address;
+    uint32_t value;
+} PPUCommand;
+
+struct ppu_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    bool waiting;
+    bool quit;
+
+    // single producer, single consumer ring
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    PPUCommand commands[PPU_WORKER_COMMANDS];
+    PPULine lines[PPU_DISPLAY_HEIGHT];
+
+    // worker side state
+    uint8_t vram[VRAM_BANKS][VRAM_BANK_SIZE];
+    uint32_t bg_colors[8][4];
+    uint32_t* display;
+};
+
+static void ppu_worker_wake(PPUWorker* worker) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->waiting) {
+        pthread_cond_signal(&worker->work);
+    }
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static void ppu_worker_push(PPUWorker* worker, PPUCommand command) {
+    uint32_t head = atomic_load_explicit(&worker->head, memory_order_relaxed);
+
+    // full ring, let the worker catch up
+    while (head - atomic_load_explicit(&worker->tail, memory_order_acquire) >= PPU_WORKER_COMMANDS) {
+        ppu_worker_wake(worker);
+        sched_yield();
+    }
+
+    worker->commands[head % PPU_WORKER_COMMANDS] = command;
+    atomic_store_explicit(&worker->head, head + 1, memory_order_release);
+}
+
+static void ppu_worker_run_command(PPUWorker* worker, const PPUCommand* command) {
+    switch (command->type) {
+        case COMMAND_VRAM:
+            worker->vram[command->address >> 13][command->address & (VRAM_BANK_SIZE - 1)] = command->value;
+            break;
+        case COMMAND_COLOR:
+            worker->bg_colors[command->index >> 2][command->index & 3] = command->value;
+            break;
+        case COMMAND_LINE: {
+            const PPULine* line = &worker->lines[command->index];
+            ppu_render_line(line, worker->vram, worker->bg_colors, worker->display + line->scanline * PPU_DISPLAY_WIDTH);
+            break;
+        }
+    }
+}
+
+static void* ppu_worker_run(void* arg) {
+    PPUWorker* worker = arg;
+
+    for (;;) {
+        uint32_t tail = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&worker->head, memory_order_acquire);
+
+        if (tail == head) {
+            pthread_mutex_lock(&worker->lock);
+            pthread_cond_broadcast(&worker->idle);
+            while (!worker->quit && tail == atomic_load_explicit(&worker->head, memory_order_acquire)) {
+                worker->waiting = true;
+                pthread_cond_wait(&worker->work, &worker->lock);
+            }
+            worker->waiting = false;
+            bool quit = worker->quit;
+            pthread_mutex_unlock(&worker->lock);
+
+            if (quit) {
+                break;
+            }
+            continue;
+        }
+
+        while (tail != head) {
+            ppu_worker_run_command(worker, &worker->commands[tail % PPU_WORKER_COMMANDS]);
+            tail++;
+        }
+        atomic_store_explicit(&worker->tail, tail, memory_order_release);
+    }
+
+    return NULL;
+}
+
+PPUWorker* ppu_worker_create(MMU* mmu, uint32_t* display) {
+    PPUWorker* worker = calloc(1, sizeof(PPUWorker));
+    if (worker == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->work, NULL);
+    pthread_cond_init(&worker->idle, NULL);
+    worker->display = display;
+    ppu_worker_reset(worker, mmu);
+
+    if (pthread_create(&worker->thread, NULL, ppu_worker_run, worker) != 0) {
+        pthread_mutex_destroy(&worker->lock);
+        pthread_cond_destroy(&worker->work);
+        pthread_cond_destroy(&worker->idle);
+        free(worker);
+        return NULL;
+    }
+
+    return worker;
+}
+
+void ppu_worker_reset(PPUWorker* worker, MMU* mmu) {
+    // only valid while the worker is idle
+    memcpy(worker->vram, mmu->vram, (mmu->cgb ? VRAM_BANKS : 1) * VRAM_BANK_SIZE);
+    memcpy(worker->bg_colors, mmu->bg_colors, sizeof(worker->bg_colors));
+}
+
+void ppu_worker_vram(PPUWorker* worker, uint16_t offset, uint8_t value) {
+    PPUCommand command = { COMMAND_VRAM, 0, offset, value };
+    ppu_worker_push(worker, command);
+}
+
+void ppu_worker_color(PPUWorker* worker, int palette, int index, uint32_t color) {
+    PPUCommand command = { COMMAND_COLOR, palette * 4 + index, 0, color };
+    ppu_worker_push(worker, command);
+}
+
+void ppu_worker_line(PPUWorker* worker, const PPULine* line) {
+    // lines are only reused after the frame's sync, so the slot is free
+    worker->lines[line->scanline] = *line;
+
+    PPUCommand command = { COMMAND_LINE, line->scanline, 0, 0 };
+    ppu_worker_push(worker, command);
+    ppu_worker_wake(worker);
+}
+
+void ppu_worker_sync(PPUWorker* worker) {
+    pthread_mutex_lock(&worker->lock);
+    if (worker->waiting) {
+        pthread_cond_signal(&worker->work);
+    }
+    while (atomic_load_explicit(&worker->tail, memory_order_acquire) != atomic_load_explicit(&worker->head, memory_order_relaxed)) {
+        pthread_cond_wait(&worker->idle, &worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void ppu_worker_destroy(PPUWorker* worker) {
+    pthread_mutex_lock(&worker->lock);
+    worker->quit = true;
+    pthread_cond_signal(&worker->work);
+    pthread_mutex_unlock(&worker->lock);
+
+    pthread_join(worker->thread, NULL);
+    pthread_mutex_destroy(&worker->lock);
+    pthread_cond_destroy(&worker->work);
+    pthread_cond_destroy(&worker->idle);
+    free(worker);
+}
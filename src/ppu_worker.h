@@ -0,0 +1,20 @@
+#ifndef PPU_WORKER_H
+#define PPU_WORKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ppu.h"
+
+#define PPU_WORKER_COMMANDS 0x8000
+
+typedef struct ppu_worker PPUWorker;
+
+PPUWorker* ppu_worker_create(MMU* mmu, uint32_t* display);
+void ppu_worker_reset(PPUWorker* worker, MMU* mmu);
+void ppu_worker_vram(PPUWorker* worker, uint16_t offset, uint8_t value);
+void ppu_worker_color(PPUWorker* worker, int palette, int index, uint32_t color);
+void ppu_worker_line(PPUWorker* worker, const PPULine* line);
+void ppu_worker_sync(PPUWorker* worker);
+void ppu_worker_destroy(PPUWorker* worker);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rom.h"
+
+// every rom currently open, instances can come and go from any thread
+static Rom* roms = NULL;
+static pthread_mutex_t roms_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static Rom* rom_map(int fd, const struct stat* info) {
+    Rom* rom = calloc(1, sizeof(Rom));
+    if (rom == NULL) {
+        return NULL;
+    }
+
+    // zero pages past the end of small roms, then the file over the front of them
+    long page = sysconf(_SC_PAGESIZE);
+    rom->size = info->st_size;
+    rom->mapped = rom->size > ROM_MIN_SIZE ? rom->size : ROM_MIN_SIZE;
+    rom->mapped = (rom->mapped + page - 1) / page * page;
+
+    uint8_t* data = mmap(NULL, rom->mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        free(rom);
+        return NULL;
+    }
+
+    if (rom->size > 0 && mmap(data, rom->size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(data, rom->mapped);
+        free(rom);
+        return NULL;
+    }
+
+    rom->data = data;
+    rom->device = info->st_dev;
+    rom->inode = info->st_ino;
+    return rom;
+}
+
+Rom* rom_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&roms_lock);
+
+    Rom* rom = roms;
+    while (rom != NULL && (rom->device != info.st_dev || rom->inode != info.st_ino)) {
+        rom = rom->next;
+    }
+
+    if (rom == NULL) {
+        rom = rom_map(fd, &info);
+        if (rom != NULL) {
+            rom->next = roms;
+            roms = rom;
+        }
+    }
+
+    if (rom != NULL) {
+        rom->refs++;
+    }
+
+    pthread_mutex_unlock(&roms_lock);
+    close(fd);
+
+    return rom;
+}
+
+void rom_release(Rom* rom) {
+    pthread_mutex_lock(&roms_lock);
+
+    if (--rom->refs > 0) {
+        pthread_mutex_unlock(&roms_lock);
+        return;
+    }
+
+    Rom** link = &roms;
+    while (*link != rom) {
+        link = &(*link)->next;
+    }
+    *link = rom->next;
+
+    pthread_mutex_unlock(&roms_lock);
+
+    munmap((void*)rom->data, rom->mapped);
+    free(rom);
+}
@@ -0,0 +1,25 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define ROM_MIN_SIZE 0x8000 // banks 0 and 1 are always mapped
+
+// a cartridge rom mapped read only and shared by every instance of the same file
+typedef struct rom {
+    const uint8_t* data;
+    long size;
+    long mapped;
+
+    // identity of the file, and the instances using it
+    dev_t device;
+    ino_t inode;
+    int refs;
+    struct rom* next;
+} Rom;
+
+Rom* rom_open(const char* path);
+void rom_release(Rom* rom);
+
+#endif
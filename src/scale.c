@@ -0,0 +1,401 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scale.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BORDER 2 // xbr reads two pixels past the edge
+
+typedef struct {
+    const uint32_t* source;
+    int source_pitch;
+    int width;
+    uint32_t* dest;
+    int pitch;
+    int factor;
+} ScaleJob;
+
+static const char* filter_names[SCALE_FILTERS] = { "nearest", "scale2x", "scale3x", "xbr2x" };
+
+int scale_filter_factor(ScaleFilter filter) {
+    switch (filter) {
+        case SCALE_SCALE2X: return 2;
+        case SCALE_SCALE3X: return 3;
+        case SCALE_XBR2X: return 2;
+        default: return 1;
+    }
+}
+
+const char* scale_filter_name(ScaleFilter filter) {
+    return filter_names[filter];
+}
+
+int scale_filter_parse(const char* name) {
+    for (int i = 0; i < SCALE_FILTERS; i++) {
+        if (strcmp(name, filter_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool scaler_initialize(Scaler* scaler, int width, int height, int scale, ScaleFilter filter, int threads) {
+    memset(scaler, 0, sizeof(Scaler));
+    scaler->scale = scale < 1 ? 1 : scale;
+    scaler->source_width = width;
+    scaler->source_height = height;
+    scaler->width = width * scaler->scale;
+    scaler->height = height * scaler->scale;
+
+    scaler->padded = calloc((width + BORDER * 2) * (height + BORDER * 2), sizeof(uint32_t));
+    scaler->buffer = calloc(width * 3 * height * 3, sizeof(uint32_t));
+    scaler->pool = pool_create(threads);
+    if (scaler->padded == NULL || scaler->buffer == NULL || scaler->pool == NULL) {
+        scaler_close(scaler);
+        return false;
+    }
+
+    scaler_set_filter(scaler, filter);
+    return true;
+}
+
+void scaler_set_filter(Scaler* scaler, ScaleFilter filter) {
+    // filters need a scale that is a multiple of their own factor
+    int factor = scale_filter_factor(filter);
+    scaler->filter = (scaler->scale % factor == 0) ? filter : SCALE_NEAREST;
+}
+
+void scaler_next_filter(Scaler* scaler) {
+    ScaleFilter filter = scaler->filter;
+    do {
+        filter = (filter + 1) % SCALE_FILTERS;
+    } while (scaler->scale % scale_filter_factor(filter) != 0);
+    scaler->filter = filter;
+}
+
+// nearest integer
+
+static void nearest_row(const uint32_t* in, int width, uint32_t* out, int factor) {
+    int x = 0;
+
+#ifdef __SSE2__
+    if (factor == 2) {
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+            _mm_storeu_si128((__m128i*)(out + x * 2), _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128((__m128i*)(out + x * 2 + 4), _mm_unpackhi_epi32(v, v));
+        }
+    } else if (factor == 3) {
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+            _mm_storeu_si128((__m128i*)(out + x * 3), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+            _mm_storeu_si128((__m128i*)(out + x * 3 + 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+            _mm_storeu_si128((__m128i*)(out + x * 3 + 8), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+        }
+    } else if (factor >= 4) {
+        for (; x < width; x++) {
+            __m128i v = _mm_set1_epi32(in[x]);
+            uint32_t* run = out + x * factor;
+            int i = 0;
+            for (; i + 4 <= factor; i += 4) {
+                _mm_storeu_si128((__m128i*)(run + i), v);
+            }
+            for (; i < factor; i++) {
+                run[i] = in[x];
+            }
+        }
+    }
+#endif
+
+    for (; x < width; x++) {
+        for (int i = 0; i < factor; i++) {
+            out[x * factor + i] = in[x];
+        }
+    }
+}
+
+static void nearest_task(void* arg, int start, int end) {
+    ScaleJob* job = arg;
+    int row_size = job->width * job->factor * sizeof(uint32_t);
+
+    for (int y = start; y < end; y++) {
+        uint32_t* out = job->dest + y * job->factor * job->pitch;
+        nearest_row(job->source + y * job->source_pitch, job->width, out, job->factor);
+        for (int i = 1; i < job->factor; i++) {
+            memcpy(out + i * job->pitch, out, row_size);
+        }
+    }
+}
+
+// scale2x / scale3x
+//   A B C
+//   D E F
+//   G H I
+
+#ifdef __SSE2__
+static inline __m128i select128(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline void store3(uint32_t* out, __m128i a, __m128i b, __m128i c) {
+    // a0 b0 c0 a1 | b1 c1 a2 b2 | c2 a3 b3 c3
+    __m128 ab_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));
+    __m128 ca_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a));
+    __m128 bc_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));
+    __m128 ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));
+    __m128 ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a));
+    __m128 bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));
+    _mm_storeu_ps((float*)out, _mm_shuffle_ps(ab_lo, ca_lo, _MM_SHUFFLE(3, 0, 1, 0)));
+    _mm_storeu_ps((float*)(out + 4), _mm_shuffle_ps(bc_lo, ab_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_ps((float*)(out + 8), _mm_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 3, 0)));
+}
+#endif
+
+static void scale2x_task(void* arg, int start, int end) {
+    ScaleJob* job = arg;
+    int sp = job->source_pitch;
+
+    for (int y = start; y < end; y++) {
+        const uint32_t* e = job->source + y * sp;
+        uint32_t* out0 = job->dest + y * 2 * job->pitch;
+        uint32_t* out1 = out0 + job->pitch;
+        int x = 0;
+
+#ifdef __SSE2__
+        for (; x + 4 <= job->width; x += 4) {
+            __m128i vb = _mm_loadu_si128((const __m128i*)(e + x - sp));
+            __m128i vd = _mm_loadu_si128((const __m128i*)(e + x - 1));
+            __m128i ve = _mm_loadu_si128((const __m128i*)(e + x));
+            __m128i vf = _mm_loadu_si128((const __m128i*)(e + x + 1));
+            __m128i vh = _mm_loadu_si128((const __m128i*)(e + x + sp));
+
+            __m128i db = _mm_cmpeq_epi32(vd, vb);
+            __m128i bf = _mm_cmpeq_epi32(vb, vf);
+            __m128i dh = _mm_cmpeq_epi32(vd, vh);
+            __m128i hf = _mm_cmpeq_epi32(vh, vf);
+
+            __m128i e0 = select128(_mm_andnot_si128(_mm_or_si128(bf, dh), db), vd, ve);
+            __m128i e1 = select128(_mm_andnot_si128(_mm_or_si128(db, hf), bf), vf, ve);
+            __m128i e2 = select128(_mm_andnot_si128(_mm_or_si128(db, hf), dh), vd, ve);
+            __m128i e3 = select128(_mm_andnot_si128(_mm_or_si128(dh, bf), hf), vf, ve);
+
+            _mm_storeu_si128((__m128i*)(out0 + x * 2), _mm_unpacklo_epi32(e0, e1));
+            _mm_storeu_si128((__m128i*)(out0 + x * 2 + 4), _mm_unpackhi_epi32(e0, e1));
+            _mm_storeu_si128((__m128i*)(out1 + x * 2), _mm_unpacklo_epi32(e2, e3));
+            _mm_storeu_si128((__m128i*)(out1 + x * 2 + 4), _mm_unpackhi_epi32(e2, e3));
+        }
+#endif
+
+        for (; x < job->width; x++) {
+            uint32_t B = e[x - sp], D = e[x - 1], E = e[x], F = e[x + 1], H = e[x + sp];
+            out0[x * 2] = (D == B && B != F && D != H) ? D : E;
+            out0[x * 2 + 1] = (B == F && B != D && F != H) ? F : E;
+            out1[x * 2] = (D == H && D != B && H != F) ? D : E;
+            out1[x * 2 + 1] = (H == F && D != H && B != F) ? F : E;
+        }
+    }
+}
+
+static void scale3x_task(void* arg, int start, int end) {
+    ScaleJob* job = arg;
+    int sp = job->source_pitch;
+
+    for (int y = start; y < end; y++) {
+        const uint32_t* e = job->source + y * sp;
+        uint32_t* out0 = job->dest + y * 3 * job->pitch;
+        uint32_t* out1 = out0 + job->pitch;
+        uint32_t* out2 = out1 + job->pitch;
+        int x = 0;
+
+#ifdef __SSE2__
+        for (; x + 4 <= job->width; x += 4) {
+            __m128i va = _mm_loadu_si128((const __m128i*)(e + x - sp - 1));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(e + x - sp));
+            __m128i vc = _mm_loadu_si128((const __m128i*)(e + x - sp + 1));
+            __m128i vd = _mm_loadu_si128((const __m128i*)(e + x - 1));
+            __m128i ve = _mm_loadu_si128((const __m128i*)(e + x));
+            __m128i vf = _mm_loadu_si128((const __m128i*)(e + x + 1));
+            __m128i vg = _mm_loadu_si128((const __m128i*)(e + x + sp - 1));
+            __m128i vh = _mm_loadu_si128((const __m128i*)(e + x + sp));
+            __m128i vi = _mm_loadu_si128((const __m128i*)(e + x + sp + 1));
+
+            __m128i db = _mm_cmpeq_epi32(vd, vb);
+            __m128i bf = _mm_cmpeq_epi32(vb, vf);
+            __m128i dh = _mm_cmpeq_epi32(vd, vh);
+            __m128i hf = _mm_cmpeq_epi32(vh, vf);
+            __m128i ea = _mm_cmpeq_epi32(ve, va);
+            __m128i ec = _mm_cmpeq_epi32(ve, vc);
+            __m128i eg = _mm_cmpeq_epi32(ve, vg);
+            __m128i ei = _mm_cmpeq_epi32(ve, vi);
+
+            // corner conditions, as in scale2x
+            __m128i k0 = _mm_andnot_si128(_mm_or_si128(bf, dh), db);
+            __m128i k2 = _mm_andnot_si128(_mm_or_si128(db, hf), bf);
+            __m128i k6 = _mm_andnot_si128(_mm_or_si128(db, hf), dh);
+            __m128i k8 = _mm_andnot_si128(_mm_or_si128(dh, bf), hf);
+
+            __m128i e0 = select128(k0, vd, ve);
+            __m128i e1 = select128(_mm_or_si128(_mm_andnot_si128(ec, k0), _mm_andnot_si128(ea, k2)), vb, ve);
+            __m128i e2 = select128(k2, vf, ve);
+            __m128i e3 = select128(_mm_or_si128(_mm_andnot_si128(eg, k0), _mm_andnot_si128(ea, k6)), vd, ve);
+            __m128i e5 = select128(_mm_or_si128(_mm_andnot_si128(ei, k2), _mm_andnot_si128(ec, k8)), vf, ve);
+            __m128i e6 = select128(k6, vd, ve);
+            __m128i e7 = select128(_mm_or_si128(_mm_andnot_si128(ei, k6), _mm_andnot_si128(eg, k8)), vh, ve);
+            __m128i e8 = select128(k8, vf, ve);
+
+            store3(out0 + x * 3, e0, e1, e2);
+            store3(out1 + x * 3, e3, ve, e5);
+            store3(out2 + x * 3, e6, e7, e8);
+        }
+#endif
+
+        for (; x < job->width; x++) {
+            uint32_t A = e[x - sp - 1], B = e[x - sp], C = e[x - sp + 1];
+            uint32_t D = e[x - 1], E = e[x], F = e[x + 1];
+            uint32_t G = e[x + sp - 1], H = e[x + sp], I = e[x + sp + 1];
+            bool k0 = D == B && B != F && D != H;
+            bool k2 = B == F && B != D && F != H;
+            bool k6 = D == H && D != B && H != F;
+            bool k8 = H == F && D != H && B != F;
+            out0[x * 3] = k0 ? D : E;
+            out0[x * 3 + 1] = ((k0 && E != C) || (k2 && E != A)) ? B : E;
+            out0[x * 3 + 2] = k2 ? F : E;
+            out1[x * 3] = ((k0 && E != G) || (k6 && E != A)) ? D : E;
+            out1[x * 3 + 1] = E;
+            out1[x * 3 + 2] = ((k2 && E != I) || (k8 && E != C)) ? F : E;
+            out2[x * 3] = k6 ? D : E;
+            out2[x * 3 + 1] = ((k6 && E != I) || (k8 && E != G)) ? H : E;
+            out2[x * 3 + 2] = k8 ? F : E;
+        }
+    }
+}
+
+// xbr 2x (hyllian's level 1 edge rule)
+//      A1 B1 C1
+//   A0 A  B  C  C4
+//   D0 D  E  F  F4
+//   G0 G  H  I  I4
+//      G5 H5 I5
+
+static inline int xbr_distance(uint32_t a, uint32_t b) {
+    // weighted yuv difference of rgba8888 pixels
+    int r = (int)(a >> 24) - (int)(b >> 24);
+    int g = (int)((a >> 16) & 0xFF) - (int)((b >> 16) & 0xFF);
+    int bl = (int)((a >> 8) & 0xFF) - (int)((b >> 8) & 0xFF);
+    int y = abs(r * 299 + g * 587 + bl * 114) / 1000;
+    int u = abs(-r * 169 - g * 331 + bl * 500) / 1000;
+    int v = abs(r * 500 - g * 419 - bl * 81) / 1000;
+    return y * 48 + u * 7 + v * 6;
+}
+
+static inline uint32_t xbr_blend(uint32_t a, uint32_t b) {
+    return ((a & 0xFEFEFEFE) >> 1) + ((b & 0xFEFEFEFE) >> 1) + (a & b & 0x01010101);
+}
+
+// the bottom right corner, the other corners pass mirrored neighbours
+static inline uint32_t xbr_corner(uint32_t E, uint32_t I, uint32_t H, uint32_t F, uint32_t G, uint32_t C,
+                                  uint32_t D, uint32_t B, uint32_t F4, uint32_t I4, uint32_t H5, uint32_t I5) {
+    if (E == H || E == F) {
+        return E;
+    }
+
+    int edge = xbr_distance(E, C) + xbr_distance(E, G) + xbr_distance(I, F4) + xbr_distance(I, H5) + 4 * xbr_distance(H, F);
+    int cross = xbr_distance(H, D) + xbr_distance(H, I5) + xbr_distance(F, I4) + xbr_distance(F, B) + 4 * xbr_distance(E, I);
+    if (edge >= cross) {
+        return E;
+    }
+
+    return xbr_blend(E, xbr_distance(E, F) <= xbr_distance(E, H) ? F : H);
+}
+
+static void xbr2x_task(void* arg, int start, int end) {
+    ScaleJob* job = arg;
+    int sp = job->source_pitch;
+
+    for (int y = start; y < end; y++) {
+        const uint32_t* e = job->source + y * sp;
+        uint32_t* out0 = job->dest + y * 2 * job->pitch;
+        uint32_t* out1 = out0 + job->pitch;
+
+        for (int x = 0; x < job->width; x++) {
+            const uint32_t* p = e + x;
+            uint32_t A1 = p[-2 * sp - 1], B1 = p[-2 * sp], C1 = p[-2 * sp + 1];
+            uint32_t A0 = p[-sp - 2], A = p[-sp - 1], B = p[-sp], C = p[-sp + 1], C4 = p[-sp + 2];
+            uint32_t D0 = p[-2], D = p[-1], E = p[0], F = p[1], F4 = p[2];
+            uint32_t G0 = p[sp - 2], G = p[sp - 1], H = p[sp], I = p[sp + 1], I4 = p[sp + 2];
+            uint32_t G5 = p[2 * sp - 1], H5 = p[2 * sp], I5 = p[2 * sp + 1];
+
+            out0[x * 2] = xbr_corner(E, A, B, D, C, G, F, H, D0, A0, B1, A1);
+            out0[x * 2 + 1] = xbr_corner(E, C, B, F, A, I, D, H, F4, C4, B1, C1);
+            out1[x * 2] = xbr_corner(E, G, H, D, I, A, F, B, D0, G0, H5, G5);
+            out1[x * 2 + 1] = xbr_corner(E, I, H, F, G, C, D, B, F4, I4, H5, I5);
+        }
+    }
+}
+
+void scaler_run(Scaler* scaler, const uint32_t* source, uint32_t* dest, int pitch) {
+    int width = scaler->source_width;
+    int height = scaler->source_height;
+    int padded_pitch = width + BORDER * 2;
+
+    // replicate the edges so the filters never bounds check
+    for (int y = -BORDER; y < height + BORDER; y++) {
+        int sy = y < 0 ? 0 : (y >= height ? height - 1 : y);
+        uint32_t* row = scaler->padded + (y + BORDER) * padded_pitch;
+        const uint32_t* in = source + sy * width;
+        memcpy(row + BORDER, in, width * sizeof(uint32_t));
+        for (int i = 0; i < BORDER; i++) {
+            row[i] = in[0];
+            row[BORDER + width + i] = in[width - 1];
+        }
+    }
+
+    ScaleJob job;
+    job.source = scaler->padded + BORDER * padded_pitch + BORDER;
+    job.source_pitch = padded_pitch;
+    job.width = width;
+
+    if (scaler->filter == SCALE_NEAREST) {
+        job.dest = dest;
+        job.pitch = pitch;
+        job.factor = scaler->scale;
+        pool_run(scaler->pool, nearest_task, &job, height);
+        return;
+    }
+
+    // the filter goes straight to the output when it already is the full scale
+    int factor = scale_filter_factor(scaler->filter);
+    bool direct = factor == scaler->scale;
+    job.dest = direct ? dest : scaler->buffer;
+    job.pitch = direct ? pitch : width * factor;
+    job.factor = factor;
+
+    switch (scaler->filter) {
+        case SCALE_SCALE2X: pool_run(scaler->pool, scale2x_task, &job, height); break;
+        case SCALE_SCALE3X: pool_run(scaler->pool, scale3x_task, &job, height); break;
+        case SCALE_XBR2X: pool_run(scaler->pool, xbr2x_task, &job, height); break;
+        default: break;
+    }
+
+    if (!direct) {
+        ScaleJob rest;
+        rest.source = scaler->buffer;
+        rest.source_pitch = width * factor;
+        rest.width = width * factor;
+        rest.dest = dest;
+        rest.pitch = pitch;
+        rest.factor = scaler->scale / factor;
+        pool_run(scaler->pool, nearest_task, &rest, height * factor);
+    }
+}
+
+void scaler_close(Scaler* scaler) {
+    if (scaler->pool != NULL) {
+        pool_destroy(scaler->pool);
+    }
+    free(scaler->padded);
+    free(scaler->buffer);
+    memset(scaler, 0, sizeof(Scaler));
+}
@@ -0,0 +1,43 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pool.h"
+
+typedef enum {
+    SCALE_NEAREST,
+    SCALE_SCALE2X,
+    SCALE_SCALE3X,
+    SCALE_XBR2X,
+    SCALE_FILTERS,
+} ScaleFilter;
+
+typedef struct scaler {
+    ScaleFilter filter;
+    int scale;
+
+    // source and output size
+    int source_width;
+    int source_height;
+    int width;
+    int height;
+
+    // rows are split across the pool
+    Pool* pool;
+
+    // source with a replicated border, filter output before the final integer scale
+    uint32_t* padded;
+    uint32_t* buffer;
+} Scaler;
+
+bool scaler_initialize(Scaler* scaler, int width, int height, int scale, ScaleFilter filter, int threads);
+int scale_filter_factor(ScaleFilter filter);
+const char* scale_filter_name(ScaleFilter filter);
+int scale_filter_parse(const char* name);
+void scaler_set_filter(Scaler* scaler, ScaleFilter filter);
+void scaler_next_filter(Scaler* scaler);
+void scaler_run(Scaler* scaler, const uint32_t* source, uint32_t* dest, int pitch);
+void scaler_close(Scaler* scaler);
+
+#endif
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "serial.h"
+
+#define SB 0xFF01
+#define SC 0xFF02
+#define IF 0xFF0F
+
+// sync packet flags
+#define LINK_MASTER 0x01 // internal clock transfer waiting for the peer
+#define LINK_SLAVE 0x02  // external clock transfer armed
+
+void serial_initialize(Serial* serial, SerialMode mode) {
+    memset(serial, 0, sizeof(Serial));
+    serial->mode = mode;
+    serial->fd = -1;
+    serial->quantum = SERIAL_QUANTUM;
+}
+
+static bool serial_address(struct sockaddr_un* address, const char* path) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Error: Link socket path too long %s\n", path);
+        return false;
+    }
+    strcpy(address->sun_path, path);
+    return true;
+}
+
+bool serial_host(Serial* serial, const char* path, int quantum) {
+    struct sockaddr_un address;
+    if (!serial_address(&address, path)) {
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 1) < 0) {
+        fprintf(stderr, "Error: Couldn't listen on %s\n", path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    printf("Waiting for link on %s\n", path);
+    serial->fd = accept(fd, NULL, NULL);
+    close(fd);
+    unlink(path);
+
+    if (serial->fd < 0) {
+        fprintf(stderr, "Error: Couldn't accept link on %s\n", path);
+        return false;
+    }
+
+    serial->mode = SERIAL_LINK;
+    serial->quantum = quantum;
+    return true;
+}
+
+bool serial_join(Serial* serial, const char* path, int quantum) {
+    struct sockaddr_un address;
+    if (!serial_address(&address, path)) {
+        return false;
+    }
+
+    serial->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (serial->fd < 0 || connect(serial->fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        fprintf(stderr, "Error: Couldn't connect link to %s\n", path);
+        serial_close(serial);
+        return false;
+    }
+
+    serial->mode = SERIAL_LINK;
+    serial->quantum = quantum;
+    return true;
+}
+
+static void serial_complete(MMU* mmu, uint8_t value) {
+    mmu_write(mmu, SB, value);
+    mmu_write(mmu, SC, mmu_read(mmu, SC) & 0x7F);
+    mmu_write(mmu, IF, mmu_read(mmu, IF) | 0x08);
+}
+
+static bool serial_exchange(Serial* serial, const uint8_t* out, uint8_t* in) {
+    if (send(serial->fd, out, 2, MSG_NOSIGNAL) != 2) {
+        return false;
+    }
+
+    int received = 0;
+    while (received < 2) {
+        ssize_t n = read(serial->fd, in + received, 2 - received);
+        if (n <= 0) {
+            return false;
+        }
+        received += n;
+    }
+
+    return true;
+}
+
+static void serial_sync(Serial* serial, MMU* mmu) {
+    uint8_t sc = mmu_read(mmu, SC);
+    bool slave = (sc & 0x81) == 0x80;
+
+    // both sides swap flags and sb at the same emulated cycle
+    uint8_t out[2] = { (serial->pending ? LINK_MASTER : 0) | (slave ? LINK_SLAVE : 0), mmu_read(mmu, SB) };
+    uint8_t in[2];
+
+    if (!serial_exchange(serial, out, in)) {
+        fprintf(stderr, "Link disconnected\n");
+        serial_close(serial);
+        serial->mode = SERIAL_NONE;
+
+        // a transfer waiting on the peer finishes as an unplugged cable would
+        bool pending = serial->pending;
+        serial->pending = false;
+        serial->active = false;
+        if (pending) {
+            serial_complete(mmu, 0xFF);
+        }
+        return;
+    }
+
+    if (serial->pending) {
+        serial->pending = false;
+        serial->active = false;
+        serial_complete(mmu, (in[0] & LINK_SLAVE) ? in[1] : 0xFF);
+    } else if (slave && (in[0] & LINK_MASTER)) {
+        serial_complete(mmu, in[1]);
+    }
+}
+
+void serial_cycle(Serial* serial, MMU* mmu, int cycles) {
+    uint8_t sc = mmu_read(mmu, SC);
+
+    // internal clock transfer started or cancelled
+    if (!serial->active && (sc & 0x81) == 0x81) {
+        serial->active = true;
+        serial->transfer_cycles = SERIAL_CYCLES;
+    } else if (serial->active && !(sc & 0x80)) {
+        serial->active = false;
+        serial->pending = false;
+    }
+
+    if (serial->active && !serial->pending) {
+        serial->transfer_cycles -= cycles;
+        if (serial->transfer_cycles <= 0) {
+            if (serial->mode == SERIAL_LINK) {
+                // finishes at the next sync
+                serial->pending = true;
+            } else {
+                uint8_t value = mmu_read(mmu, SB);
+                if (serial->mode == SERIAL_STDOUT && !serial->silent) {
+                    putchar(value);
+                    fflush(stdout);
+                }
+                serial->active = false;
+                serial_complete(mmu, 0xFF);
+            }
+        }
+    }
+
+    if (serial->mode == SERIAL_LINK) {
+        serial->sync_cycles += cycles;
+        if (serial->sync_cycles >= serial->quantum) {
+            serial->sync_cycles -= serial->quantum;
+            serial_sync(serial, mmu);
+        }
+    }
+}
+
+void serial_close(Serial* serial) {
+    if (serial->fd >= 0) {
+        close(serial->fd);
+        serial->fd = -1;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mmu.h"
+
+#define SERIAL_CYCLES 4096 // 8 bits at 8192Hz
+#define SERIAL_QUANTUM SERIAL_CYCLES
+
+typedef enum {
+    SERIAL_NONE,   // no cable, transfers read 0xFF
+    SERIAL_STDOUT, // no cable, sent bytes are printed
+    SERIAL_LINK,   // cable to another instance
+} SerialMode;
+
+typedef struct serial {
+    SerialMode mode;
+
+    // transfer
+    bool active;
+    bool pending;
+    int transfer_cycles;
+
+    // link - both sides sync every quantum cycles
+    int fd;
+    int quantum;
+    int sync_cycles;
+
+    // frames that will be rolled back print nothing
+    bool silent;
+} Serial;
+
+void serial_initialize(Serial* serial, SerialMode mode);
+bool serial_host(Serial* serial, const char* path, int quantum);
+bool serial_join(Serial* serial, const char* path, int quantum);
+void serial_cycle(Serial* serial, MMU* mmu, int cycles);
+void serial_close(Serial* serial);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "ppu_worker.h"
+
+// a save is a handful of memcpys - the mmu struct, the ram banks in use
+// and cart ram - so run-ahead can take one every frame
+
+Snapshot* snapshot_create(GameBoy* gb) {
+    Snapshot* snapshot = calloc(1, sizeof(Snapshot));
+    if (snapshot == NULL) {
+        return NULL;
+    }
+
+    snapshot->cart_ram_size = gb->cart.ram != NULL ? gb->cart.ram_size : 0;
+    if (snapshot->cart_ram_size > 0) {
+        snapshot->cart_ram = malloc(snapshot->cart_ram_size);
+        if (snapshot->cart_ram == NULL) {
+            free(snapshot);
+            return NULL;
+        }
+    }
+
+    // an instance that never loaded a boot rom takes this one, so a load never allocates
+    if (gb->mmu.boot != NULL) {
+        snapshot->boot_overlay = malloc(BOOT_SIZE);
+        if (snapshot->boot_overlay == NULL) {
+            snapshot_destroy(snapshot);
+            return NULL;
+        }
+    }
+
+    // a save file is mapped shared, frames that get rolled back need their own copy
+    if (snapshot->cart_ram_size > 0 && gb->cart.save_fd >= 0) {
+        snapshot->private_ram = malloc(snapshot->cart_ram_size);
+        if (snapshot->private_ram == NULL) {
+            snapshot_destroy(snapshot);
+            return NULL;
+        }
+    }
+
+    return snapshot;
+}
+
+static int snapshot_vram_banks(MMU* mmu) {
+    return mmu->cgb ? VRAM_BANKS : 1;
+}
+
+static int snapshot_wram_banks(MMU* mmu) {
+    return mmu->cgb ? WRAM_BANKS : 2;
+}
+
+void snapshot_save(Snapshot* snapshot, GameBoy* gb) {
+    MMU* mmu = &gb->mmu;
+
+    snapshot->cpu = gb->cpu;
+    snapshot->mmu = *mmu;
+    memcpy(snapshot->vram, mmu->vram, snapshot_vram_banks(mmu) * VRAM_BANK_SIZE);
+    memcpy(snapshot->wram, mmu->wram, snapshot_wram_banks(mmu) * WRAM_BANK_SIZE);
+    if (mmu->boot_mapped) {
+        memcpy(snapshot->boot_rom, mmu->boot, BOOT_SIZE);
+    }
+
+    snapshot->ppu_cycle_count = gb->ppu.cycle_count;
+    snapshot->ppu_scanline = gb->ppu.scanline;
+    snapshot->ppu_mode = gb->ppu.mode;
+    snapshot->ppu_frame = gb->ppu.frame;
+
+    snapshot->apu_sample_clock = gb->apu.sample_clock;
+    snapshot->apu_cycles = gb->apu.cycles;
+    snapshot->apu_phase = gb->apu.phase;
+
+    snapshot->serial_active = gb->serial.active;
+    snapshot->serial_pending = gb->serial.pending;
+    snapshot->serial_transfer_cycles = gb->serial.transfer_cycles;
+    snapshot->serial_sync_cycles = gb->serial.sync_cycles;
+
+    snapshot->cart_ram_bank = gb->cart.ram_bank;
+    snapshot->cart_ram_enabled = gb->cart.ram_enabled;
+    snapshot->cart_mbc1_mode = gb->cart.mbc1_mode;
+    if (snapshot->cart_ram_size > 0) {
+        memcpy(snapshot->cart_ram, gb->cart.ram, snapshot->cart_ram_size);
+    }
+}
+
+void snapshot_load(Snapshot* snapshot, GameBoy* gb) {
+    MMU* mmu = &gb->mmu;
+
+    // the worker has to be idle before its copy of vram is replaced
+    if (mmu->worker != NULL) {
+        ppu_worker_sync(mmu->worker);
+    }
+
+    // the instance keeps its own buffers, threads, debugger and register handlers
+    MMU live = *mmu;
+    *mmu = snapshot->mmu;
+    mmu->vram = live.vram;
+    mmu->wram = live.wram;
+    mmu->cart = live.cart;
+    mmu->boot = live.boot;
+    mmu->worker = live.worker;
+    mmu->debugger = live.debugger;
+    mmu->watch_read = live.watch_read;
+    mmu->watch_write = live.watch_write;
+    memcpy(mmu->io_context, live.io_context, sizeof(mmu->io_context));
+    memcpy(mmu->vram, snapshot->vram, snapshot_vram_banks(mmu) * VRAM_BANK_SIZE);
+    memcpy(mmu->wram, snapshot->wram, snapshot_wram_banks(mmu) * WRAM_BANK_SIZE);
+
+    // the boot rom may have been unmapped since the save, its buffer is still there
+    if (mmu->boot_mapped && mmu->boot == NULL) {
+        mmu->boot = snapshot->boot_overlay;
+        snapshot->boot_overlay = NULL;
+    }
+    if (mmu->boot == NULL) {
+        mmu->boot_mapped = false;
+    } else if (mmu->boot_mapped) {
+        memcpy(mmu->boot, snapshot->boot_rom, BOOT_SIZE);
+    }
+
+    gb->cpu = snapshot->cpu;
+    gb->ppu.cycle_count = snapshot->ppu_cycle_count;
+    gb->ppu.scanline = snapshot->ppu_scanline;
+    gb->ppu.mode = snapshot->ppu_mode;
+    gb->ppu.frame = snapshot->ppu_frame;
+
+    gb->apu.sample_clock = snapshot->apu_sample_clock;
+    gb->apu.cycles = snapshot->apu_cycles;
+    gb->apu.phase = snapshot->apu_phase;
+
+    gb->serial.active = snapshot->serial_active;
+    gb->serial.pending = snapshot->serial_pending;
+    gb->serial.transfer_cycles = snapshot->serial_transfer_cycles;
+    gb->serial.sync_cycles = snapshot->serial_sync_cycles;
+
+    // back to the save file, which the private frames never touched
+    if (snapshot->saved_ram != NULL) {
+        gb->cart.ram = snapshot->saved_ram;
+        gb->cart.ram_dirty = snapshot->saved_dirty;
+        snapshot->saved_ram = NULL;
+    }
+
+    gb->cart.ram_bank = snapshot->cart_ram_bank;
+    gb->cart.ram_enabled = snapshot->cart_ram_enabled;
+    gb->cart.mbc1_mode = snapshot->cart_mbc1_mode;
+    // only a real change marks battery ram for saving
+    if (snapshot->cart_ram_size > 0 && memcmp(gb->cart.ram, snapshot->cart_ram, snapshot->cart_ram_size) != 0) {
+        memcpy(gb->cart.ram, snapshot->cart_ram, snapshot->cart_ram_size);
+        gb->cart.ram_dirty = true;
+    }
+
+    mmu_remap(mmu);
+    if (mmu->worker != NULL) {
+        ppu_worker_reset(mmu->worker, mmu);
+    }
+}
+
+void snapshot_private_ram(Snapshot* snapshot, GameBoy* gb) {
+    // cart ram writes go to a copy until the next load, so a crash before
+    // then can't leave them in the save file
+    if (snapshot->private_ram == NULL || snapshot->saved_ram != NULL) {
+        return;
+    }
+
+    memcpy(snapshot->private_ram, gb->cart.ram, snapshot->cart_ram_size);
+    snapshot->saved_ram = gb->cart.ram;
+    snapshot->saved_dirty = gb->cart.ram_dirty;
+    gb->cart.ram = snapshot->private_ram;
+    mmu_remap(&gb->mmu);
+}
+
+void snapshot_destroy(Snapshot* snapshot) {
+    free(snapshot->cart_ram);
+    free(snapshot->private_ram);
+    free(snapshot->boot_overlay);
+    free(snapshot);
+}
@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gameboy.h"
+
+// everything a frame can change, restored into the instance it came from
+// (or any other running the same rom in the same mode)
+typedef struct snapshot {
+    CPU cpu;
+    MMU mmu;
+    uint8_t vram[VRAM_BANKS][VRAM_BANK_SIZE];
+    uint8_t wram[WRAM_BANKS][WRAM_BANK_SIZE];
+    uint8_t boot_rom[BOOT_SIZE];
+    uint8_t* boot_overlay;
+
+    // ppu timing, the display itself is left alone
+    int ppu_cycle_count;
+    int ppu_scanline;
+    int ppu_mode;
+    uint32_t ppu_frame;
+
+    // apu sample timing
+    uint64_t apu_sample_clock;
+    int apu_cycles;
+    int apu_phase;
+
+    // serial transfer
+    bool serial_active;
+    bool serial_pending;
+    int serial_transfer_cycles;
+    int serial_sync_cycles;
+
+    // cartridge banking and ram
+    int cart_ram_bank;
+    bool cart_ram_enabled;
+    bool cart_mbc1_mode;
+    uint8_t* cart_ram;
+    long cart_ram_size;
+
+    // battery ram swapped out for a private copy until the next load
+    uint8_t* private_ram;
+    uint8_t* saved_ram;
+    bool saved_dirty;
+} Snapshot;
+
+Snapshot* snapshot_create(GameBoy* gb);
+void snapshot_save(Snapshot* snapshot, GameBoy* gb);
+void snapshot_load(Snapshot* snapshot, GameBoy* gb);
+void snapshot_private_ram(Snapshot* snapshot, GameBoy* gb);
+void snapshot_destroy(Snapshot* snapshot);
+
+#endif
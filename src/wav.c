@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "wav.h"
+
+// the emulation thread pushes samples into a lock free ring, a writer
+// thread drains it to the file in blocks so disk stalls never reach the
+// emulator, which only waits when the ring is full - until the writer
+// frees the next block
+
+struct wav_writer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t space;
+    bool waiting;
+    bool full;
+    bool quit;
+
+    // single producer, single consumer ring
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    int16_t samples[WAV_SAMPLES];
+    uint64_t pushed;
+
+    // writer side
+    FILE* file;
+    bool header;
+    int sample_rate;
+    uint64_t written;
+};
+
+static void wav_put32(uint8_t* out, uint32_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+}
+
+static void wav_write_header(WavWriter* writer) {
+    // sizes are patched on close, streams that can't seek keep the maximum
+    uint32_t data_size = writer->written * 2 > 0xFFFFFFDB ? 0xFFFFFFDB : writer->written * 2;
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    wav_put32(header + 4, 36 + data_size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    wav_put32(header + 16, 16);
+    header[20] = 1; header[21] = 0; // pcm
+    header[22] = 1; header[23] = 0; // mono
+    wav_put32(header + 24, writer->sample_rate);
+    wav_put32(header + 28, writer->sample_rate * 2);
+    header[32] = 2; header[33] = 0; // block align
+    header[34] = 16; header[35] = 0; // bits per sample
+    memcpy(header + 36, "data", 4);
+    wav_put32(header + 40, data_size);
+    fwrite(header, 1, sizeof(header), writer->file);
+}
+
+static void wav_drain(WavWriter* writer, uint32_t tail, uint32_t head) {
+    // little endian 16-bit, converted a block at a time
+    uint8_t block[WAV_BLOCK * 2];
+    while (tail != head) {
+        int count = 0;
+        while (tail != head && count < WAV_BLOCK) {
+            uint16_t sample = writer->samples[tail % WAV_SAMPLES];
+            block[count * 2] = sample;
+            block[count * 2 + 1] = sample >> 8;
+            count++;
+            tail++;
+        }
+        atomic_store_explicit(&writer->tail, tail, memory_order_release);
+
+        // a producer blocked on a full ring can carry on
+        pthread_mutex_lock(&writer->lock);
+        if (writer->full) {
+            writer->full = false;
+            pthread_cond_signal(&writer->space);
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        fwrite(block, 2, count, writer->file);
+        writer->written += count;
+    }
+}
+
+static void* wav_run(void* arg) {
+    WavWriter* writer = arg;
+
+    for (;;) {
+        uint32_t tail = atomic_load_explicit(&writer->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&writer->head, memory_order_acquire);
+
+        if (tail != head) {
+            wav_drain(writer, tail, head);
+            continue;
+        }
+
+        // wake ups are only sent once per block, so never sleep for long
+        pthread_mutex_lock(&writer->lock);
+        bool quit = writer->quit;
+        if (!quit) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 10000000;
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            writer->waiting = true;
+            pthread_cond_timedwait(&writer->work, &writer->lock, &until);
+            writer->waiting = false;
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        if (quit) {
+            // the producer has stopped, take whatever is left
+            wav_drain(writer, tail, atomic_load_explicit(&writer->head, memory_order_acquire));
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static WavWriter* wav_start(FILE* file, bool header, int sample_rate) {
+    WavWriter* writer = calloc(1, sizeof(WavWriter));
+    if (writer == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->work, NULL);
+    pthread_cond_init(&writer->space, NULL);
+    writer->file = file;
+    writer->header = header;
+    writer->sample_rate = sample_rate;
+
+    if (header) {
+        wav_write_header(writer);
+    }
+
+    if (pthread_create(&writer->thread, NULL, wav_run, writer) != 0) {
+        fclose(file);
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->work);
+        pthread_cond_destroy(&writer->space);
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+WavWriter* wav_open(const char* path, int sample_rate) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Couldn't open %s\n", path);
+        return NULL;
+    }
+
+    return wav_start(file, true, sample_rate);
+}
+
+WavWriter* wav_open_fd(int fd, int sample_rate) {
+    FILE* file = fdopen(fd, "wb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    return wav_start(file, false, sample_rate);
+}
+
+void wav_write(WavWriter* writer, int16_t sample) {
+    uint32_t head = atomic_load_explicit(&writer->head, memory_order_relaxed);
+
+    // full ring, wait for the disk instead of dropping audio
+    if (head - atomic_load_explicit(&writer->tail, memory_order_acquire) >= WAV_SAMPLES) {
+        pthread_mutex_lock(&writer->lock);
+        while (head - atomic_load_explicit(&writer->tail, memory_order_acquire) >= WAV_SAMPLES) {
+            writer->full = true;
+            if (writer->waiting) {
+                pthread_cond_signal(&writer->work);
+            }
+            pthread_cond_wait(&writer->space, &writer->lock);
+        }
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    writer->samples[head % WAV_SAMPLES] = sample;
+    atomic_store_explicit(&writer->head, head + 1, memory_order_release);
+    writer->pushed++;
+
+    if ((head + 1) % WAV_BLOCK == 0) {
+        pthread_mutex_lock(&writer->lock);
+        if (writer->waiting) {
+            pthread_cond_signal(&writer->work);
+        }
+        pthread_mutex_unlock(&writer->lock);
+    }
+}
+
+uint64_t wav_samples(WavWriter* writer) {
+    return writer->pushed;
+}
+
+void wav_close(WavWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+    writer->quit = true;
+    pthread_cond_signal(&writer->work);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+
+    // patch the sizes now that they are known
+    if (writer->header && fseek(writer->file, 0, SEEK_SET) == 0) {
+        wav_write_header(writer);
+    }
+
+    fclose(writer->file);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->work);
+    pthread_cond_destroy(&writer->space);
+    free(writer);
+}
@@ -0,0 +1,19 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WAV_SAMPLES 0x10000 // ring size, about 1.5s at 44100Hz
+#define WAV_BLOCK 1024      // samples per write and per wake up
+
+typedef struct wav_writer WavWriter;
+
+// mono 16-bit pcm, a wav file or raw samples to a file descriptor
+WavWriter* wav_open(const char* path, int sample_rate);
+WavWriter* wav_open_fd(int fd, int sample_rate);
+void wav_write(WavWriter* writer, int16_t sample);
+uint64_t wav_samples(WavWriter* writer);
+void wav_close(WavWriter* writer);
+
+#endif